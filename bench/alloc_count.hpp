@@ -0,0 +1,64 @@
+// 基准用的堆分配计数: 替换全局 operator new / delete 的所有形式 (含数组、sized 与 nothrow 版本),
+// 统一走 malloc / free. 每个基准只能在一个翻译单元中包含本文件
+#pragma once
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace kgraphviz_bench {
+
+static std::atomic<size_t> g_allocs(0);
+static std::atomic<size_t> g_bytes(0);
+
+inline void* counted_alloc(size_t n) noexcept {
+    ++g_allocs;
+    g_bytes += n;
+    return std::malloc(n ? n : 1);
+}
+
+inline void* counted_alloc_or_throw(size_t n) {
+    if (void* p = counted_alloc(n)) return p;
+    throw std::bad_alloc();
+}
+
+} // namespace kgraphviz_bench
+
+void* operator new(size_t n) {
+    return kgraphviz_bench::counted_alloc_or_throw(n);
+}
+
+void* operator new[](size_t n) {
+    return kgraphviz_bench::counted_alloc_or_throw(n);
+}
+
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+    return kgraphviz_bench::counted_alloc(n);
+}
+
+void* operator new[](size_t n, const std::nothrow_t&) noexcept {
+    return kgraphviz_bench::counted_alloc(n);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,96 @@
+// 图构建的堆分配次数与耗时:
+//   g++ -std=c++11 -O2 -Iinclude bench/build_alloc_bench.cpp -o build_alloc_bench
+//   ./build_alloc_bench [edges] [nodes]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../include/kgraphviz/graph.hpp"
+#include "alloc_count.hpp"
+
+using kgraphviz_bench::g_allocs;
+using kgraphviz_bench::g_bytes;
+
+struct Edge {
+    std::string tail, head;
+};
+
+static std::vector<Edge> make_edges(size_t n_edges, size_t n_nodes) {
+    std::vector<Edge> edges;
+    edges.reserve(n_edges);
+    unsigned seed = 12345;
+    for (size_t i = 0; i < n_edges; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        // 名字超过 SSO 长度, 与真实包名类似
+        edges.push_back(Edge{"package-" + std::to_string(i % n_nodes) + "-x86_64",
+                             "library-" + std::to_string(seed % n_nodes) + "-x86_64"});
+    }
+    return edges;
+}
+
+template <typename Build>
+static void run(const char* name, Build build) {
+    size_t allocs0 = g_allocs, bytes0 = g_bytes;
+    auto t0 = std::chrono::steady_clock::now();
+    size_t dot_bytes = build();
+    auto t1 = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    std::printf("%-28s %10zu allocs %12zu bytes %9.2f ms  (dot %zu bytes)\n",
+                name,
+                g_allocs - allocs0,
+                g_bytes - bytes0,
+                ms,
+                dot_bytes);
+}
+
+int main(int argc, char** argv) {
+    size_t n_edges = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    size_t n_nodes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5000;
+    const std::vector<Edge> input = make_edges(n_edges, n_nodes);
+    std::printf("%zu edges over %zu nodes\n", n_edges, n_nodes);
+
+    // 输入在计时前生成好, 只统计图本身的分配
+    run("edge(const&)", [&] {
+        kgraphviz::DiGraph g("deps");
+        for (const auto& e : input) {
+            g.edge(e.tail, e.head, {{"color", "gray"}});
+        }
+        return g.to_string().size();
+    });
+
+    run("edge + reserve", [&] {
+        kgraphviz::DiGraph g("deps");
+        g.reserve(input.size(), input.size());
+        for (const auto& e : input) {
+            g.edge(e.tail, e.head, {{"color", "gray"}});
+        }
+        return g.to_string().size();
+    });
+
+    run("edge + reserve + arena", [&] {
+        auto arena = std::make_shared<kgraphviz::MonotonicArena>(1 << 20);
+        kgraphviz::DiGraph g("deps", false, arena);
+        g.reserve(input.size(), input.size());
+        for (const auto& e : input) {
+            g.edge(e.tail, e.head, {{"color", "gray"}});
+        }
+        return g.to_string().size();
+    });
+
+    // 子图: 拷贝与移动
+    kgraphviz::DiGraph sub("sub");
+    for (const auto& e : input) sub.edge(e.tail, e.head);
+    run("subgraph(const&)", [&] {
+        kgraphviz::DiGraph g("outer");
+        g.subgraph(sub);
+        return size_t(0);
+    });
+    run("subgraph(&&)", [&] {
+        kgraphviz::DiGraph g("outer");
+        g.subgraph(std::move(sub));
+        return size_t(0);
+    });
+    return 0;
+}
@@ -0,0 +1,195 @@
+// 基准用的确定性图生成器: 同样的 (shape, edges, seed) 总是生成同样的图.
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../include/kgraphviz/graph.hpp"
+
+namespace kgraphviz_bench {
+
+enum class Shape {
+    Dag,      // 随机 DAG, 每个节点约 3 条入边, 只从编号小的节点指向编号大的节点
+    Tree,     // 随机递归树, 父节点在已有节点中均匀选取
+    Grid,     // 二维网格, 右邻和下邻各一条边
+    Clusters, // 每 20 个节点一个 cluster, 内部稠密, cluster 之间少量边
+    Labels,   // 长标签: 引号、换行、反斜杠、非 ASCII, 考验转义
+    Nested    // 多层嵌套子图, 叶子子图中是短链
+};
+
+static const Shape AllShapes[] = {Shape::Dag, Shape::Tree, Shape::Grid, Shape::Clusters, Shape::Labels, Shape::Nested};
+
+inline const char* shape_name(Shape s) {
+    switch (s) {
+        case Shape::Dag: return "dag";
+        case Shape::Tree: return "tree";
+        case Shape::Grid: return "grid";
+        case Shape::Clusters: return "clusters";
+        case Shape::Labels: return "labels";
+        case Shape::Nested: return "nested";
+    }
+    return "?";
+}
+
+inline bool parse_shape(const std::string& name, Shape& out) {
+    for (Shape s : AllShapes) {
+        if (name == shape_name(s)) {
+            out = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+// xorshift64*, 与平台和标准库实现无关
+class Rng {
+  public:
+    explicit Rng(uint64_t seed) : state_(seed ? seed : 0x9e3779b97f4a7c15ULL) {}
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ULL;
+    }
+
+    // [0, n)
+    size_t below(size_t n) {
+        return n ? static_cast<size_t>(next() % n) : 0;
+    }
+
+  private:
+    uint64_t state_;
+};
+
+// 名字超过 SSO 长度, 与真实包名类似
+inline std::string node_name(size_t i) {
+    return "package-" + std::to_string(i) + "-x86_64";
+}
+
+class GraphGenerator {
+  public:
+    GraphGenerator(Shape shape, size_t edges, uint64_t seed = 1) : shape_(shape), edges_(edges), rng_(seed) {}
+
+    // 生成到 g 中 (g 应为空的有向图); 返回实际的边数
+    size_t generate(kgraphviz::BaseGraph& g) {
+        g.reserve(edges_ * 2, edges_);
+        switch (shape_) {
+            case Shape::Dag: return dag(g);
+            case Shape::Tree: return tree(g);
+            case Shape::Grid: return grid(g);
+            case Shape::Clusters: return clusters(g);
+            case Shape::Labels: return labels(g);
+            case Shape::Nested: return nested(g);
+        }
+        return 0;
+    }
+
+  private:
+    Shape shape_;
+    size_t edges_;
+    Rng rng_;
+
+    size_t dag(kgraphviz::BaseGraph& g) {
+        size_t n = std::max<size_t>(edges_ / 3, 2);
+        size_t count = 0;
+        for (size_t i = 1; count < edges_; i = i % (n - 1) + 1) {
+            g.edge(node_name(rng_.below(i)), node_name(i));
+            ++count;
+        }
+        return count;
+    }
+
+    size_t tree(kgraphviz::BaseGraph& g) {
+        for (size_t i = 1; i <= edges_; ++i) g.edge(node_name(rng_.below(i)), node_name(i));
+        return edges_;
+    }
+
+    size_t grid(kgraphviz::BaseGraph& g) {
+        size_t w = std::max<size_t>(static_cast<size_t>(std::sqrt(edges_ / 2.0)), 1);
+        size_t count = 0;
+        for (size_t y = 0; count < edges_; ++y) {
+            for (size_t x = 0; x < w && count < edges_; ++x) {
+                std::string here = "r" + std::to_string(y) + "c" + std::to_string(x);
+                if (x + 1 < w) {
+                    g.edge(here, "r" + std::to_string(y) + "c" + std::to_string(x + 1));
+                    ++count;
+                }
+                if (count < edges_) {
+                    g.edge(here, "r" + std::to_string(y + 1) + "c" + std::to_string(x));
+                    ++count;
+                }
+            }
+        }
+        return count;
+    }
+
+    size_t clusters(kgraphviz::BaseGraph& g) {
+        const size_t size = 20;
+        const size_t inner = size * 3; // 每个 cluster 内部的边数
+        size_t n_clusters = std::max<size_t>(edges_ / (inner + 2), 1);
+        size_t count = 0;
+        for (size_t c = 0; c < n_clusters && count < edges_; ++c) {
+            kgraphviz::BaseGraph& sub = g.add_subgraph("c" + std::to_string(c));
+            sub.set_graph_attr("label", "cluster " + std::to_string(c));
+            for (size_t k = 0; k < inner && count < edges_; ++k) {
+                size_t a = rng_.below(size), b = rng_.below(size);
+                sub.edge(node_name(c * size + a), node_name(c * size + b));
+                ++count;
+            }
+        }
+        while (count < edges_) {
+            g.edge(node_name(rng_.below(n_clusters * size)), node_name(rng_.below(n_clusters * size)));
+            ++count;
+        }
+        return count;
+    }
+
+    size_t labels(kgraphviz::BaseGraph& g) {
+        static const char* words[] = {"lib", "\"quoted\"", "multi\nline", "back\\slash", "ünïcødé", "a b c", "node"};
+        size_t n = std::max<size_t>(edges_ / 2, 2);
+        for (size_t i = 0; i < n; ++i) {
+            std::string label;
+            for (int k = 0; k < 8; ++k) {
+                if (k) label += ' ';
+                label += words[rng_.below(sizeof(words) / sizeof(words[0]))];
+            }
+            g.node(node_name(i), label, {{"tooltip", label + " / " + std::to_string(i)}});
+        }
+        for (size_t i = 0; i < edges_; ++i) {
+            g.edge(node_name(rng_.below(n)), node_name(rng_.below(n)), {{"label", "v" + std::to_string(i) + ".0-1"}});
+        }
+        return edges_;
+    }
+
+    size_t nested(kgraphviz::BaseGraph& g) {
+        size_t count = 0, next_node = 0;
+        nest(g, 0, count, next_node);
+        while (count < edges_) {
+            g.edge(node_name(rng_.below(next_node)), node_name(rng_.below(next_node)));
+            ++count;
+        }
+        return count;
+    }
+
+    // 每层 4 个子图, 深 4 层, 叶子子图中放一条短链
+    void nest(kgraphviz::BaseGraph& g, int depth, size_t& count, size_t& next_node) {
+        if (depth == 4) {
+            size_t chain = std::max<size_t>(edges_ / 256 / 2, 1);
+            for (size_t k = 0; k < chain && count < edges_; ++k, ++next_node, ++count) {
+                g.edge(node_name(next_node), node_name(next_node + 1));
+            }
+            ++next_node;
+            return;
+        }
+        for (int i = 0; i < 4 && count < edges_; ++i) {
+            kgraphviz::BaseGraph& sub = g.add_subgraph("d" + std::to_string(depth) + "_" + std::to_string(next_node));
+            nest(sub, depth + 1, count, next_node);
+        }
+    }
+};
+
+} // namespace kgraphviz_bench
@@ -0,0 +1,277 @@
+// 构建 / 序列化 / 进程启动 / 端到端渲染的基准, 结果以 JSON 输出, 便于在 CI 中比较:
+//   g++ -std=c++11 -O2 -pthread -Iinclude bench/render_bench.cpp -o render_bench
+//   ./render_bench [--sizes=100,1000,10000,100000,1000000] [--shapes=dag,tree,grid,clusters,labels,nested]
+//                  [--engines=dot,neato] [--format=svg] [--render-max=1000] [--reps=5] [--out=results.json]
+// 图由 graph_gen.hpp 确定性地生成; 只有边数不超过 --render-max 的图才会交给 engine 渲染.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alloc_count.hpp"
+#include "graph_gen.hpp"
+
+using kgraphviz_bench::g_allocs;
+using kgraphviz_bench::g_bytes;
+
+using Clock = std::chrono::steady_clock;
+using kgraphviz_bench::Shape;
+
+static double ms_since(Clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+struct Stats {
+    double min = 0;
+    double median = 0;
+    double mean = 0;
+};
+
+static Stats stats_of(std::vector<double> v) {
+    Stats s;
+    if (v.empty()) return s;
+    std::sort(v.begin(), v.end());
+    s.min = v.front();
+    s.median = v[v.size() / 2];
+    for (double x : v) s.mean += x;
+    s.mean /= static_cast<double>(v.size());
+    return s;
+}
+
+static std::vector<std::string> split_list(const std::string& s) {
+    std::vector<std::string> out;
+    size_t begin = 0;
+    while (begin <= s.size()) {
+        size_t comma = s.find(',', begin);
+        if (comma == std::string::npos) comma = s.size();
+        if (comma > begin) out.push_back(s.substr(begin, comma - begin));
+        begin = comma + 1;
+    }
+    return out;
+}
+
+// 每条结果一个 JSON 对象, 最后组成 {"meta": ..., "results": [...]}
+class JsonOut {
+  public:
+    void begin(const char* bench) {
+        cur_ = "{\"bench\": \"";
+        cur_ += bench;
+        cur_ += '"';
+    }
+
+    void field(const char* key, const std::string& value) {
+        cur_ += ", \"";
+        cur_ += key;
+        cur_ += "\": \"";
+        for (char c : value) {
+            if (c == '"' || c == '\\') cur_ += '\\';
+            if (static_cast<unsigned char>(c) < 0x20) {
+                cur_ += ' ';
+                continue;
+            }
+            cur_ += c;
+        }
+        cur_ += '"';
+    }
+
+    void field(const char* key, double value) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%.3f", value);
+        raw(key, buf);
+    }
+
+    void field(const char* key, size_t value) {
+        raw(key, std::to_string(value));
+    }
+
+    void end() {
+        cur_ += '}';
+        std::fprintf(stderr, "%s\n", cur_.c_str());
+        results_.push_back(cur_);
+    }
+
+    std::string document() const {
+        std::string doc = "{\"meta\": {\"version\": 1, \"hardware_concurrency\": ";
+        doc += std::to_string(std::thread::hardware_concurrency());
+        doc += "},\n \"results\": [\n";
+        for (size_t i = 0; i < results_.size(); ++i) {
+            doc += "  " + results_[i] + (i + 1 < results_.size() ? ",\n" : "\n");
+        }
+        doc += "]}\n";
+        return doc;
+    }
+
+  private:
+    std::string cur_;
+    std::vector<std::string> results_;
+
+    void raw(const char* key, const std::string& value) {
+        cur_ += ", \"";
+        cur_ += key;
+        cur_ += "\": ";
+        cur_ += value;
+    }
+};
+
+// 构建耗时与分配次数; 图留在 g 中供后续步骤使用, 返回实际生成的边数
+static size_t bench_build(JsonOut& json, Shape shape, size_t edges, kgraphviz::DiGraph& g) {
+    size_t allocs0 = g_allocs, bytes0 = g_bytes;
+    Clock::time_point t0 = Clock::now();
+    size_t actual = kgraphviz_bench::GraphGenerator(shape, edges).generate(g);
+    double ms = ms_since(t0);
+
+    json.begin("build");
+    json.field("shape", kgraphviz_bench::shape_name(shape));
+    json.field("edges", actual);
+    json.field("ms", ms);
+    json.field("allocs", g_allocs - allocs0);
+    json.field("alloc_bytes", g_bytes - bytes0);
+    json.end();
+    return actual;
+}
+
+static void bench_to_string(JsonOut& json, Shape shape, size_t edges, const kgraphviz::DiGraph& g, int reps) {
+    std::vector<double> times;
+    size_t bytes = 0, allocs = 0;
+    for (int r = 0; r < reps; ++r) {
+        size_t allocs0 = g_allocs;
+        Clock::time_point t0 = Clock::now();
+        bytes = g.to_string().size();
+        times.push_back(ms_since(t0));
+        allocs = g_allocs - allocs0;
+    }
+    Stats s = stats_of(times);
+
+    json.begin("to_string");
+    json.field("shape", kgraphviz_bench::shape_name(shape));
+    json.field("edges", edges);
+    json.field("bytes", bytes);
+    json.field("ms_min", s.min);
+    json.field("ms_median", s.median);
+    json.field("mb_per_s", s.min > 0 ? bytes / 1e3 / s.min : 0.0);
+    json.field("allocs", allocs);
+    json.end();
+}
+
+// 空图的渲染时间约等于启动 engine 进程的固定开销
+static void bench_spawn(JsonOut& json, const std::string& engine, const std::string& format, int reps) {
+    kgraphviz::DiGraph empty("empty");
+    kgraphviz::RenderOptions opts = kgraphviz::RenderOptions().set_engine(engine).set_format(format);
+    std::vector<double> times;
+    json.begin("spawn");
+    json.field("engine", engine);
+    json.field("format", format);
+    try {
+        for (int r = 0; r < reps; ++r) {
+            Clock::time_point t0 = Clock::now();
+            empty.render_to_memory(opts);
+            times.push_back(ms_since(t0));
+        }
+        Stats s = stats_of(times);
+        json.field("ms_min", s.min);
+        json.field("ms_median", s.median);
+        json.field("ms_mean", s.mean);
+    } catch (const std::exception& e) {
+        json.field("error", e.what());
+    }
+    json.end();
+}
+
+static void bench_render(JsonOut& json,
+                         Shape shape,
+                         size_t edges,
+                         const kgraphviz::DiGraph& g,
+                         const std::string& engine,
+                         const std::string& format,
+                         int reps) {
+    kgraphviz::RenderOptions opts = kgraphviz::RenderOptions().set_engine(engine).set_format(format);
+    std::vector<double> times;
+    size_t out_bytes = 0;
+    json.begin("render");
+    json.field("shape", kgraphviz_bench::shape_name(shape));
+    json.field("edges", edges);
+    json.field("engine", engine);
+    json.field("format", format);
+    try {
+        for (int r = 0; r < reps; ++r) {
+            Clock::time_point t0 = Clock::now();
+            out_bytes = g.render_to_memory(opts).size();
+            times.push_back(ms_since(t0));
+        }
+        Stats s = stats_of(times);
+        json.field("ms_min", s.min);
+        json.field("ms_median", s.median);
+        json.field("output_bytes", out_bytes);
+    } catch (const std::exception& e) {
+        json.field("error", e.what());
+    }
+    json.end();
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> sizes = split_list("100,1000,10000,100000,1000000");
+    std::vector<std::string> shapes = split_list("dag,tree,grid,clusters,labels,nested");
+    std::vector<std::string> engines = split_list("dot");
+    std::string format = "svg";
+    std::string out_path;
+    size_t render_max = 1000;
+    int reps = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value = arg.find('=') == std::string::npos ? "" : arg.substr(arg.find('=') + 1);
+        if (arg.compare(0, 8, "--sizes=") == 0) {
+            sizes = split_list(value);
+        } else if (arg.compare(0, 9, "--shapes=") == 0) {
+            shapes = split_list(value);
+        } else if (arg.compare(0, 10, "--engines=") == 0) {
+            engines = split_list(value);
+        } else if (arg.compare(0, 9, "--format=") == 0) {
+            format = value;
+        } else if (arg.compare(0, 13, "--render-max=") == 0) {
+            render_max = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg.compare(0, 7, "--reps=") == 0) {
+            reps = std::max(1, std::atoi(value.c_str()));
+        } else if (arg.compare(0, 6, "--out=") == 0) {
+            out_path = value;
+        } else {
+            std::fprintf(stderr, "unknown argument: %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    JsonOut json;
+    for (const auto& engine : engines) bench_spawn(json, engine, format, reps);
+
+    for (const auto& shape_name : shapes) {
+        Shape shape;
+        if (! kgraphviz_bench::parse_shape(shape_name, shape)) {
+            std::fprintf(stderr, "unknown shape: %s\n", shape_name.c_str());
+            return 2;
+        }
+        for (const auto& size : sizes) {
+            kgraphviz::DiGraph g("bench");
+            size_t edges = bench_build(json, shape, std::strtoul(size.c_str(), nullptr, 10), g);
+            bench_to_string(json, shape, edges, g, reps);
+            if (edges > render_max) continue;
+            for (const auto& engine : engines) bench_render(json, shape, edges, g, engine, format, reps);
+        }
+    }
+
+    std::string doc = json.document();
+    if (out_path.empty()) {
+        std::fputs(doc.c_str(), stdout);
+        return 0;
+    }
+    FILE* f = std::fopen(out_path.c_str(), "w");
+    if (! f) {
+        std::perror(out_path.c_str());
+        return 1;
+    }
+    std::fputs(doc.c_str(), f);
+    std::fclose(f);
+    return 0;
+}
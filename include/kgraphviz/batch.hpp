@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "graph.hpp"
+#include "source.hpp"
+#include "options.hpp"
+
+namespace kgraphviz {
+
+struct RenderResult {
+    std::vector<uint8_t> data;  // 内存渲染任务的输出; 文件任务为空
+    std::exception_ptr error;   // 任务失败时的异常 (通常是 CalledProcessError)
+    std::string error_message;  // error 的 what(), 便于直接打印
+
+    bool ok() const {
+        return ! error;
+    }
+
+    void rethrow() const {
+        if (error) std::rethrow_exception(error);
+    }
+};
+
+// 一个渲染任务. 只保存对 graph / source 的引用, 调用方需保证其在 RenderPool::run 返回前有效
+class RenderJob {
+  public:
+    static RenderJob
+    to_file(const BaseGraph& g, const std::string& output_path, const RenderOptions& options = RenderOptions()) {
+        return RenderJob([&g, output_path, options](RenderResult&) { g.render(output_path, options); });
+    }
+
+    static RenderJob to_memory(const BaseGraph& g, const RenderOptions& options) {
+        return RenderJob([&g, options](RenderResult& r) { r.data = g.render_to_memory(options); });
+    }
+
+    static RenderJob
+    to_file(const Source& src, const std::string& output_path, const RenderOptions& options = RenderOptions()) {
+        return RenderJob([&src, output_path, options](RenderResult&) { src.render(output_path, options); });
+    }
+
+    static RenderJob to_memory(const Source& src, const RenderOptions& options) {
+        return RenderJob([&src, options](RenderResult& r) { r.data = src.render_to_memory(options); });
+    }
+
+    void operator()(RenderResult& result) const {
+        run_(result);
+    }
+
+  private:
+    explicit RenderJob(std::function<void(RenderResult&)> run) : run_(std::move(run)) {}
+
+    std::function<void(RenderResult&)> run_;
+};
+
+// 用固定数量的工作线程并发执行渲染任务, 同一时刻最多 concurrency 个 engine 子进程.
+// 单个任务失败只记录在对应的 RenderResult 中, 不会中断整个批次.
+class RenderPool {
+  public:
+    explicit RenderPool(size_t concurrency = 0) : concurrency_(concurrency) {
+        if (concurrency_ == 0) {
+            concurrency_ = std::thread::hardware_concurrency();
+            if (concurrency_ == 0) concurrency_ = 1;
+        }
+    }
+
+    size_t concurrency() const {
+        return concurrency_;
+    }
+
+    // 结果与 jobs 一一对应
+    std::vector<RenderResult> run(const std::vector<RenderJob>& jobs) const {
+        std::vector<RenderResult> results(jobs.size());
+        std::atomic<size_t> next(0);
+
+        auto worker = [&]() {
+            for (;;) {
+                size_t i = next++;
+                if (i >= jobs.size()) return;
+                try {
+                    jobs[i](results[i]);
+                } catch (const std::exception& e) {
+                    results[i].error = std::current_exception();
+                    results[i].error_message = e.what();
+                } catch (...) {
+                    results[i].error = std::current_exception();
+                    results[i].error_message = "unknown error";
+                }
+            }
+        };
+
+        size_t n_threads = std::min(concurrency_, jobs.size());
+        if (n_threads <= 1) {
+            worker();
+            return results;
+        }
+
+        std::vector<std::thread> threads;
+        threads.reserve(n_threads);
+        for (size_t t = 0; t < n_threads; ++t) {
+            threads.emplace_back(worker);
+        }
+        for (auto& th : threads) {
+            th.join();
+        }
+        return results;
+    }
+
+  private:
+    size_t concurrency_;
+};
+
+} // namespace kgraphviz
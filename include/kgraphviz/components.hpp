@@ -0,0 +1,316 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "batch.hpp"
+#include "graph.hpp"
+#include "options.hpp"
+
+namespace kgraphviz {
+
+// 按弱连通分量拆分渲染的选项
+struct PartitionOptions {
+    size_t max_parts = 0;   // 分量按规模均衡地装进至多这么多个子图, 每个子图一个 engine 进程; 0 为 concurrency
+    size_t concurrency = 0; // 同时运行的 engine 进程数, 0 为 CPU 核数
+    int pack_margin = -1;   // gvpack -m, 分量之间的间距 (point); < 0 使用 gvpack 的默认值
+
+    PartitionOptions& set_max_parts(size_t n) {
+        max_parts = n;
+        return *this;
+    }
+
+    PartitionOptions& set_concurrency(size_t n) {
+        concurrency = n;
+        return *this;
+    }
+
+    PartitionOptions& set_pack_margin(int margin) {
+        pack_margin = margin;
+        return *this;
+    }
+
+    // 实际使用的部分数上限
+    size_t parts() const {
+        return max_parts > 0 ? max_parts : RenderPool(concurrency).concurrency();
+    }
+};
+
+// 在整棵图 (含子图) 的边上做并查集, 同一 cluster 的节点也并在一起, 再按分量把 statements 分发到各个部分.
+// 每个部分保留原图的 statement 顺序、默认属性、子图层次和原样文本行, 只含属于它的节点和边
+class ComponentSplitter {
+  public:
+    // 每个分量的节点名, 分量和分量内的节点都按在原图中首次出现的顺序
+    static std::vector<std::vector<std::string>> components(const BaseGraph& g) {
+        ComponentSplitter s;
+        s.collect(g);
+        std::vector<std::vector<std::string>> out(s.n_components_);
+        for (size_t v = 0; v < s.names_.size(); ++v) out[s.component_[v]].push_back(s.names_[v]);
+        return out;
+    }
+
+    // max_parts == 0 时每个分量一个图; 否则按节点数 + 边数从大到小装进当前最轻的部分
+    static std::vector<BaseGraph> split(const BaseGraph& g, size_t max_parts) {
+        ComponentSplitter s;
+        s.collect(g);
+        size_t n_parts = max_parts == 0 ? s.n_components_ : std::min(max_parts, s.n_components_);
+        s.assign_parts(n_parts);
+
+        std::vector<BaseGraph> parts;
+        parts.reserve(n_parts);
+        for (size_t i = 0; i < n_parts; ++i) {
+            parts.push_back(BaseGraph(g.name(), g.is_strict(), g.is_directed()));
+            copy_defaults(g, parts.back());
+            parts.back().comment_ = g.comment_;
+        }
+        std::vector<BaseGraph*> targets(n_parts);
+        for (size_t i = 0; i < n_parts; ++i) targets[i] = &parts[i];
+        Scope root{&g, nullptr, targets, std::vector<std::string>()};
+        s.distribute(root);
+        return parts;
+    }
+
+  private:
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, uint32_t> index_;
+    std::vector<uint32_t> parent_; // 并查集
+    std::vector<uint32_t> component_;
+    std::vector<size_t> weight_; // 每个分量的节点数 + 边数
+    std::vector<uint32_t> part_; // 分量 -> 部分
+    size_t n_components_ = 0;
+
+    // 一个子图在各个部分中的副本, 只在该部分第一次用到时创建
+    struct Scope {
+        const BaseGraph* src;
+        Scope* parent;
+        std::vector<BaseGraph*> made;
+        std::vector<std::string> raw; // 已经出现过的原样文本, 新建副本时补上, 保持默认值的作用范围
+    };
+
+    uint32_t intern(StrRef name) {
+        std::string s = name.str();
+        auto it = index_.find(s);
+        if (it != index_.end()) return it->second;
+        uint32_t i = static_cast<uint32_t>(names_.size());
+        index_.emplace(s, i);
+        names_.push_back(s);
+        parent_.push_back(i);
+        return i;
+    }
+
+    uint32_t find(uint32_t v) {
+        while (parent_[v] != v) {
+            parent_[v] = parent_[parent_[v]]; // 路径减半
+            v = parent_[v];
+        }
+        return v;
+    }
+
+    void unite(uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return;
+        if (b < a) std::swap(a, b);
+        parent_[b] = a; // 小下标作根, 分量编号自然跟随出现顺序
+    }
+
+    struct Collector {
+        ComponentSplitter& s;
+        std::vector<uint32_t>& edge_tails;
+        std::vector<uint32_t>* cluster; // 所在最外层 cluster 的节点, 不在 cluster 中时为空
+
+        void raw(StrRef) {}
+
+        void node(StrRef name, const BaseGraph::AttrView&) {
+            member(s.intern(name));
+        }
+
+        void edge(StrRef tail, StrRef head, const BaseGraph::AttrView&) {
+            uint32_t t = s.intern(tail), h = s.intern(head);
+            s.unite(t, h);
+            member(t);
+            member(h);
+            edge_tails.push_back(t);
+        }
+
+        // cluster 的节点 (含嵌套子图中的) 合并为同一个分量, 保证整个 cluster 落在同一部分
+        void subgraph(const BaseGraph& sub) {
+            if (cluster || ! sub.is_cluster()) {
+                sub.visit(*this);
+                return;
+            }
+            std::vector<uint32_t> members;
+            Collector inner{s, edge_tails, &members};
+            sub.visit(inner);
+            for (uint32_t v : members) s.unite(members.front(), v);
+        }
+
+        void member(uint32_t v) {
+            if (cluster) cluster->push_back(v);
+        }
+    };
+
+    void collect(const BaseGraph& g) {
+        std::vector<uint32_t> edge_tails;
+        Collector c{*this, edge_tails, nullptr};
+        g.visit(c);
+
+        component_.assign(names_.size(), 0);
+        std::vector<uint32_t> number(names_.size(), 0xffffffffu);
+        for (uint32_t v = 0; v < names_.size(); ++v) {
+            uint32_t root = find(v);
+            if (number[root] == 0xffffffffu) number[root] = static_cast<uint32_t>(n_components_++);
+            component_[v] = number[root];
+        }
+        weight_.assign(n_components_, 0);
+        for (uint32_t v = 0; v < names_.size(); ++v) ++weight_[component_[v]];
+        for (uint32_t t : edge_tails) ++weight_[component_[t]];
+    }
+
+    void assign_parts(size_t n_parts) {
+        part_.assign(n_components_, 0);
+        if (n_parts >= n_components_) {
+            for (size_t c = 0; c < n_components_; ++c) part_[c] = static_cast<uint32_t>(c);
+            return;
+        }
+        std::vector<uint32_t> order(n_components_);
+        for (size_t c = 0; c < n_components_; ++c) order[c] = static_cast<uint32_t>(c);
+        std::stable_sort(
+            order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return weight_[a] > weight_[b]; });
+        std::vector<size_t> load(n_parts, 0);
+        for (uint32_t c : order) {
+            size_t best = static_cast<size_t>(std::min_element(load.begin(), load.end()) - load.begin());
+            part_[c] = static_cast<uint32_t>(best);
+            load[best] += weight_[c];
+        }
+    }
+
+    static void copy_defaults(const BaseGraph& from, BaseGraph& to) {
+        to.graph_attr_ = from.graph_attr_;
+        to.node_attr_ = from.node_attr_;
+        to.edge_attr_ = from.edge_attr_;
+    }
+
+    static void push_raw(BaseGraph& g, const std::string& line) {
+        g.push_statement(BaseGraph::Statement::make_raw(g.strings_.intern(line)));
+    }
+
+    BaseGraph& target(Scope& scope, size_t part) {
+        if (! scope.made[part]) {
+            BaseGraph& outer = target(*scope.parent, part);
+            BaseGraph& sub = outer.add_subgraph(scope.src->name());
+            sub.set_cluster(scope.src->is_cluster());
+            copy_defaults(*scope.src, sub);
+            for (const auto& line : scope.raw) push_raw(sub, line);
+            scope.made[part] = &sub;
+        }
+        return *scope.made[part];
+    }
+
+    struct Distributor {
+        ComponentSplitter& s;
+        Scope& scope;
+
+        void raw(StrRef line) {
+            std::string text = line.str();
+            for (BaseGraph* g : scope.made) {
+                if (g) push_raw(*g, text);
+            }
+            scope.raw.push_back(std::move(text));
+        }
+
+        void node(StrRef name, const BaseGraph::AttrView& attrs) {
+            s.target(scope, s.part_of(name)).node(name.str(), "", to_map(attrs));
+        }
+
+        void edge(StrRef tail, StrRef head, const BaseGraph::AttrView& attrs) {
+            s.target(scope, s.part_of(tail)).edge(tail.str(), head.str(), to_map(attrs));
+        }
+
+        void subgraph(const BaseGraph& sub) {
+            Scope inner{&sub, &scope, std::vector<BaseGraph*>(scope.made.size(), nullptr), std::vector<std::string>()};
+            Distributor d{s, inner};
+            sub.visit(d);
+        }
+
+        static AttrMap to_map(const BaseGraph::AttrView& attrs) {
+            AttrMap m;
+            m.reserve(attrs.size());
+            for (const auto& kv : attrs) m.set(kv.first.str(), kv.second.str());
+            return m;
+        }
+    };
+
+    size_t part_of(StrRef name) const {
+        return part_[component_[index_.find(name.str())->second]];
+    }
+
+    void distribute(Scope& root) {
+        Distributor d{*this, root};
+        root.src->visit(d);
+    }
+};
+
+// 弱连通分量的节点名
+inline std::vector<std::vector<std::string>> connected_components(const BaseGraph& g) {
+    return ComponentSplitter::components(g);
+}
+
+// 拆成互不相连的部分; max_parts == 0 时每个分量一个图
+inline std::vector<BaseGraph> split_components(const BaseGraph& g, size_t max_parts = 0) {
+    return ComponentSplitter::split(g, max_parts);
+}
+
+// 各部分各自用一个 engine 进程并行渲染, 结果与 split_components(g, max_parts) 的部分一一对应 (分块输出).
+// 某一部分失败只记录在对应的 RenderResult 中
+inline std::vector<RenderResult> render_components(const BaseGraph& g,
+                                                  const RenderOptions& options,
+                                                  const PartitionOptions& partition = PartitionOptions()) {
+    std::vector<BaseGraph> parts = split_components(g, partition.parts());
+    std::vector<RenderJob> jobs;
+    jobs.reserve(parts.size());
+    for (const auto& part : parts) jobs.push_back(RenderJob::to_memory(part, options));
+    return RenderPool(partition.concurrency).run(jobs);
+}
+
+// 各部分并行布局 (-Tdot), 用 gvpack 拼到一起, 再用 neato -n2 按已有坐标渲染成一张图.
+// 只有一个部分时直接渲染 g, 不经过 gvpack
+inline std::vector<uint8_t> render_packed(const BaseGraph& g,
+                                          const RenderOptions& options,
+                                          const PartitionOptions& partition = PartitionOptions()) {
+    std::vector<BaseGraph> parts = split_components(g, partition.parts());
+    if (parts.size() <= 1) return g.render_to_memory(options);
+
+    RenderOptions layout_opts = options;
+    layout_opts.set_format("dot").set_renderer("").set_formatter("");
+    layout_opts.outputs.clear();
+    std::vector<RenderJob> jobs;
+    jobs.reserve(parts.size());
+    for (const auto& part : parts) jobs.push_back(RenderJob::to_memory(part, layout_opts));
+    std::vector<RenderResult> results = RenderPool(partition.concurrency).run(jobs);
+    for (const auto& r : results) r.rethrow();
+
+    std::vector<std::string> layouts;
+    layouts.reserve(results.size());
+    for (const auto& r : results) layouts.push_back(std::string(r.data.begin(), r.data.end()));
+    std::string packed = Renderer::pack_layouts(layouts, options, partition.pack_margin);
+
+    RenderOptions opts = options;
+    opts.set_engine(Layout::neato_engine(options.engine)).set_neato_no_op(true, 2);
+    return Renderer::render_from_string_to_memory(packed, opts);
+}
+
+inline void render_packed(const BaseGraph& g,
+                          const std::string& output_path,
+                          const RenderOptions& options = RenderOptions(),
+                          const PartitionOptions& partition = PartitionOptions()) {
+    RenderOptions opts = options;
+    Renderer::deduce_format(output_path, opts);
+    write_cached_output(output_path, render_packed(g, opts, partition), opts);
+}
+
+} // namespace kgraphviz
@@ -0,0 +1,143 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace kgraphviz {
+
+const static size_t ArenaMaxBlockSize = 4 << 20; // 块大小倍增的上限
+
+// 单调内存区: 只分配不单独释放, 析构 (或 release()) 时整块归还.
+// 适合 "构建 -> 渲染 -> 丢弃" 的短命图; 非线程安全, 同一 arena 不要在多个线程里同时分配
+class MonotonicArena {
+  public:
+    explicit MonotonicArena(size_t initial_block_size = 64 * 1024)
+        : next_block_size_(initial_block_size < 256 ? 256 : initial_block_size) {}
+
+    ~MonotonicArena() {
+        release();
+    }
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+        if (bytes == 0) bytes = 1;
+        char* p = align_up(cur_, align);
+        if (p == nullptr || p + bytes > end_) {
+            p = align_up(new_block(bytes + align), align);
+        }
+        cur_ = p + bytes;
+        used_ += bytes;
+        return p;
+    }
+
+    // 归还全部内存; 之前分配出的指针全部失效
+    void release() {
+        while (head_) {
+            Block* next = head_->next;
+            std::free(head_);
+            head_ = next;
+        }
+        cur_ = end_ = nullptr;
+        used_ = reserved_ = 0;
+    }
+
+    // 已分配给调用者的字节数
+    size_t bytes_used() const {
+        return used_;
+    }
+
+    // 向系统申请的字节数 (含块头和未用完的尾部)
+    size_t bytes_reserved() const {
+        return reserved_;
+    }
+
+  private:
+    struct Block {
+        Block* next;
+    };
+
+    Block* head_ = nullptr;
+    char* cur_ = nullptr;
+    char* end_ = nullptr;
+    size_t next_block_size_;
+    size_t used_ = 0;
+    size_t reserved_ = 0;
+
+    static char* align_up(char* p, size_t align) {
+        if (p == nullptr) return nullptr;
+        uintptr_t v = reinterpret_cast<uintptr_t>(p);
+        return reinterpret_cast<char*>((v + align - 1) & ~static_cast<uintptr_t>(align - 1));
+    }
+
+    char* new_block(size_t min_bytes) {
+        size_t size = next_block_size_;
+        if (size - sizeof(Block) < min_bytes) size = min_bytes + sizeof(Block);
+        Block* b = static_cast<Block*>(std::malloc(size));
+        if (! b) throw std::bad_alloc();
+
+        b->next = head_;
+        head_ = b;
+        reserved_ += size;
+        if (next_block_size_ < ArenaMaxBlockSize) next_block_size_ *= 2;
+
+        char* data = reinterpret_cast<char*>(b) + sizeof(Block);
+        end_ = reinterpret_cast<char*>(b) + size;
+        return data;
+    }
+};
+
+// 标准库容器用的分配器: 绑定 arena 时从 arena 分配且 deallocate 为空操作, 否则退回 operator new/delete.
+// 拷贝/移动/交换容器时分配器随之传播, 拷贝出的容器与源共用同一个 arena
+template <typename T>
+class ArenaAllocator {
+  public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() noexcept : arena_(nullptr) {}
+
+    explicit ArenaAllocator(MonotonicArena* arena) noexcept : arena_(arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena_(other.arena()) {}
+
+    T* allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) throw std::bad_alloc();
+        if (arena_) return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        if (! arena_) ::operator delete(p);
+    }
+
+    MonotonicArena* arena() const noexcept {
+        return arena_;
+    }
+
+  private:
+    MonotonicArena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept {
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept {
+    return a.arena() != b.arena();
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+} // namespace kgraphviz
@@ -0,0 +1,189 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cancel_token.hpp"
+#include "../exceptions.hpp"
+#include "../options.hpp"
+
+namespace kgraphviz {
+
+// render_async 的后台执行器: 至多 CPU 核数个线程, 按需创建, 空闲 2 秒后退出; 超出的任务排队.
+// 线程各自持有共享状态, 不访问静态对象, 进程退出时仍在运行的线程不受静态析构影响
+class AsyncExecutor {
+  public:
+    static void submit(std::function<void()> task) {
+        std::shared_ptr<State> s = state();
+        std::lock_guard<std::mutex> lock(s->mutex);
+        s->queue.push_back(std::move(task));
+        if (s->queue.size() > s->idle && s->threads < s->limit) {
+            try {
+                std::thread(run, s).detach();
+                ++s->threads;
+            } catch (...) {
+                if (s->threads == 0) {
+                    s->queue.pop_back(); // 没有线程能执行它
+                    throw;
+                }
+            }
+        }
+        s->cv.notify_one();
+    }
+
+  private:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> queue;
+        size_t threads = 0;
+        size_t idle = 0;
+        size_t limit = 1;
+    };
+
+    static std::shared_ptr<State> state() {
+        static const std::shared_ptr<State> s = [] {
+            std::shared_ptr<State> st = std::make_shared<State>();
+            st->limit = std::max(1u, std::thread::hardware_concurrency());
+            return st;
+        }();
+        return s;
+    }
+
+    static void run(std::shared_ptr<State> s) {
+        std::unique_lock<std::mutex> lock(s->mutex);
+        for (;;) {
+            ++s->idle;
+            bool woken = s->cv.wait_for(lock, std::chrono::seconds(2), [&s] { return ! s->queue.empty(); });
+            --s->idle;
+            if (! woken) {
+                --s->threads;
+                return;
+            }
+            std::function<void()> task = std::move(s->queue.front());
+            s->queue.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+};
+
+// render_async 返回的句柄. 渲染由 AsyncExecutor 在后台执行, 可以等待、取消或通过回调得到结果.
+// 句柄析构不会等待也不会取消渲染; 需要终止时显式调用 cancel().
+class RenderHandle {
+  public:
+    // 完成时在后台线程上调用: 成功时 error 为空, 失败时 data 为空. 调用前结果已经就绪, 回调中可以 get() 本句柄;
+    // 但不要在回调中等待其他仍在排队的渲染, 执行器的线程数有限
+    using Callback = std::function<void(const std::vector<uint8_t>& data, std::exception_ptr error)>;
+
+    RenderHandle() = default;
+
+    bool valid() const {
+        return state_ && state_->future.valid();
+    }
+
+    // 阻塞直到完成并取走结果, 失败时重新抛出 (TimeoutExpired / RenderCancelled / CalledProcessError ...).
+    // 与 std::future 一样只能调用一次
+    std::vector<uint8_t> get() {
+        check_valid();
+        return state_->future.get();
+    }
+
+    void wait() const {
+        check_valid();
+        state_->future.wait();
+    }
+
+    // 在 timeout_ms 内完成返回 true
+    bool wait_for(long timeout_ms) const {
+        check_valid();
+        return state_->future.wait_for(std::chrono::milliseconds(timeout_ms)) == std::future_status::ready;
+    }
+
+    bool ready() const {
+        return wait_for(0);
+    }
+
+    // 杀掉正在运行的 engine 子进程; 尚未启动的渲染不会再启动
+    void cancel() {
+        if (state_ && state_->token) state_->token->cancel();
+    }
+
+    // fn(options) 在后台执行并返回渲染结果; options 会被注入本句柄的取消令牌
+    template <typename Fn>
+    static RenderHandle launch(Fn fn, RenderOptions options, Callback callback = Callback()) {
+        if (! options.cancel_token) options.cancel_token = std::make_shared<CancelToken>();
+
+        auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+        RenderHandle handle;
+        handle.state_ = std::make_shared<State>();
+        handle.state_->token = options.cancel_token;
+        handle.state_->future = promise->get_future();
+
+        AsyncExecutor::submit([fn, options, callback, promise]() {
+            if (options.cancel_token->cancelled()) {
+                // 排队期间已取消, 不再启动
+                std::exception_ptr error = std::make_exception_ptr(RenderCancelled(options.engine));
+                promise->set_exception(error);
+                notify(callback, std::vector<uint8_t>(), error);
+                return;
+            }
+
+            std::vector<uint8_t> data;
+            std::exception_ptr error;
+            try {
+                data = fn(options);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            if (error) {
+                promise->set_exception(error);
+            } else if (callback) {
+                promise->set_value(data);
+            } else {
+                promise->set_value(std::move(data));
+            }
+            notify(callback, data, error);
+        });
+
+        return handle;
+    }
+
+  private:
+    struct State {
+        std::shared_ptr<CancelToken> token;
+        std::future<std::vector<uint8_t>> future;
+    };
+
+    std::shared_ptr<State> state_;
+
+    static void notify(const Callback& callback, const std::vector<uint8_t>& data, std::exception_ptr error) {
+        if (! callback) return;
+        try {
+            callback(data, error);
+        } catch (...) {
+            // 回调里的异常无处可抛, 忽略
+        }
+    }
+
+    void check_valid() const {
+        if (! valid()) {
+            throw std::logic_error("RenderHandle: no result associated (default-constructed or get() called)");
+        }
+    }
+};
+
+} // namespace kgraphviz
@@ -0,0 +1,167 @@
+#pragma once
+#include <algorithm>
+#include <initializer_list>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "small_vector.hpp"
+
+namespace kgraphviz {
+
+// 属性集合: 按 key 排序的扁平数组, 前 4 对存放在对象内部.
+// 接口与 std::map<std::string, std::string> 的常用部分一致 (operator[] / find / insert / 有序遍历),
+// 因此输出的 DOT 属性顺序不变. 通过迭代器修改 first 会破坏顺序, 只应修改 second
+class AttrMap {
+  public:
+    using key_type = std::string;
+    using mapped_type = std::string;
+    using value_type = std::pair<std::string, std::string>;
+    using iterator = value_type*;
+    using const_iterator = const value_type*;
+    using size_type = size_t;
+
+    static const size_t InlineCapacity = 4;
+
+    AttrMap() = default;
+
+    // 与 std::map 一样, 重复的 key 只保留第一个
+    AttrMap(std::initializer_list<value_type> init) {
+        items_.reserve(init.size());
+        for (const auto& kv : init) insert(kv);
+    }
+
+    AttrMap(const std::map<std::string, std::string>& m) {
+        items_.reserve(m.size());
+        for (const auto& kv : m) items_.emplace_back(kv.first, kv.second); // 已经有序
+    }
+
+    iterator begin() {
+        return items_.begin();
+    }
+    iterator end() {
+        return items_.end();
+    }
+    const_iterator begin() const {
+        return items_.begin();
+    }
+    const_iterator end() const {
+        return items_.end();
+    }
+
+    size_t size() const {
+        return items_.size();
+    }
+
+    bool empty() const {
+        return items_.empty();
+    }
+
+    void clear() {
+        items_.clear();
+    }
+
+    void reserve(size_t n) {
+        items_.reserve(n);
+    }
+
+    iterator lower_bound(const std::string& key) {
+        return std::lower_bound(items_.begin(), items_.end(), key, KeyLess());
+    }
+
+    const_iterator lower_bound(const std::string& key) const {
+        return std::lower_bound(items_.begin(), items_.end(), key, KeyLess());
+    }
+
+    iterator find(const std::string& key) {
+        iterator it = lower_bound(key);
+        return (it != end() && it->first == key) ? it : end();
+    }
+
+    const_iterator find(const std::string& key) const {
+        const_iterator it = lower_bound(key);
+        return (it != end() && it->first == key) ? it : end();
+    }
+
+    size_t count(const std::string& key) const {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    std::string& at(const std::string& key) {
+        iterator it = find(key);
+        if (it == end()) throw std::out_of_range("AttrMap::at: " + key);
+        return it->second;
+    }
+
+    const std::string& at(const std::string& key) const {
+        const_iterator it = find(key);
+        if (it == end()) throw std::out_of_range("AttrMap::at: " + key);
+        return it->second;
+    }
+
+    std::string& operator[](const std::string& key) {
+        return emplace(key, std::string()).first->second;
+    }
+
+    std::string& operator[](std::string&& key) {
+        return emplace(std::move(key), std::string()).first->second;
+    }
+
+    // key 已存在时不修改, 返回 (位置, 是否插入)
+    std::pair<iterator, bool> insert(const value_type& kv) {
+        return emplace(kv.first, kv.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& kv) {
+        return emplace(std::move(kv.first), std::move(kv.second));
+    }
+
+    template <typename K, typename V>
+    std::pair<iterator, bool> emplace(K&& key, V&& value) {
+        iterator it = lower_bound(key);
+        if (it != end() && it->first == key) return std::make_pair(it, false);
+        it = items_.insert(it, value_type(std::forward<K>(key), std::forward<V>(value)));
+        return std::make_pair(it, true);
+    }
+
+    // 插入或覆盖
+    void set(std::string key, std::string value) {
+        iterator it = lower_bound(key);
+        if (it != end() && it->first == key) {
+            it->second = std::move(value);
+        } else {
+            items_.insert(it, value_type(std::move(key), std::move(value)));
+        }
+    }
+
+    size_t erase(const std::string& key) {
+        iterator it = find(key);
+        if (it == end()) return 0;
+        items_.erase(it);
+        return 1;
+    }
+
+    iterator erase(const_iterator pos) {
+        return items_.erase(pos);
+    }
+
+    bool operator==(const AttrMap& o) const {
+        return size() == o.size() && std::equal(begin(), end(), o.begin());
+    }
+
+    bool operator!=(const AttrMap& o) const {
+        return ! (*this == o);
+    }
+
+  private:
+    struct KeyLess {
+        bool operator()(const value_type& kv, const std::string& key) const {
+            return kv.first < key;
+        }
+    };
+
+    SmallVector<value_type, InlineCapacity> items_;
+};
+
+} // namespace kgraphviz
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace kgraphviz {
+
+// 跨线程取消正在运行的渲染. cancel() 往自管道写一个字节, 使等待子进程 I/O 的 poll 立即返回
+class CancelToken {
+  public:
+    CancelToken() : cancelled_(false) {
+        fds_[0] = fds_[1] = -1;
+#if defined(__linux__)
+        if (pipe2(fds_, O_CLOEXEC | O_NONBLOCK) != 0) fds_[0] = fds_[1] = -1;
+#else
+        if (pipe(fds_) == 0) {
+            for (int fd : fds_) {
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            }
+        } else {
+            fds_[0] = fds_[1] = -1;
+        }
+#endif
+    }
+
+    ~CancelToken() {
+        if (fds_[0] >= 0) close(fds_[0]);
+        if (fds_[1] >= 0) close(fds_[1]);
+    }
+
+    CancelToken(const CancelToken&) = delete;
+    CancelToken& operator=(const CancelToken&) = delete;
+
+    void cancel() {
+        if (! cancelled_.exchange(true) && fds_[1] >= 0) {
+            ssize_t n = ::write(fds_[1], "x", 1);
+            (void)n;
+        }
+    }
+
+    bool cancelled() const {
+        return cancelled_.load();
+    }
+
+    // 供 poll 使用的读端; 自管道创建失败时为 -1, 调用方需退化为定期检查 cancelled()
+    int fd() const {
+        return fds_[0];
+    }
+
+  private:
+    std::atomic<bool> cancelled_;
+    int fds_[2];
+};
+
+} // namespace kgraphviz
@@ -0,0 +1,271 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include "../exceptions.hpp"
+
+namespace kgraphviz {
+
+// DOT 文本的词法分析器. Token 直接指向输入缓冲区, 不复制; 输入在 Token 使用期间必须保持有效.
+// 支持 // 与 /* */ 注释、行首 '#' 行、引号串 (含 \ 换行续行)、HTML 串 <...> 与 numeral
+class DotLexer {
+  public:
+    enum class Kind {
+        Id,       // 字母/数字/下划线组成的 ID 或 numeral
+        String,   // "..." , text 不含引号, 未反转义
+        Html,     // <...> , text 不含最外层尖括号
+        LBrace,   // {
+        RBrace,   // }
+        LBracket, // [
+        RBracket, // ]
+        Semicolon,
+        Comma,
+        Equal,
+        Colon,
+        Plus,
+        EdgeOp, // -> 或 --
+        End
+    };
+
+    struct Token {
+        Kind kind = Kind::End;
+        const char* data = nullptr;
+        size_t size = 0;
+        size_t line = 0;   // 从 1 开始
+        size_t column = 0; // 从 1 开始, 按字节计
+
+        std::string str() const {
+            return std::string(data, size);
+        }
+
+        bool is(Kind k) const {
+            return kind == k;
+        }
+
+        // 不区分大小写地比较关键字 (node / edge / graph / digraph / subgraph / strict)
+        bool is_keyword(const char* kw) const {
+            if (kind != Kind::Id || std::strlen(kw) != size) return false;
+            for (size_t i = 0; i < size; ++i) {
+                if ((data[i] | 0x20) != kw[i]) return false;
+            }
+            return true;
+        }
+
+        bool is_id() const {
+            return kind == Kind::Id || kind == Kind::String || kind == Kind::Html;
+        }
+    };
+
+    DotLexer(const char* data, size_t size) : p_(data), end_(data + size), line_start_(data) {}
+
+    Token next() {
+        skip_space_and_comments();
+        Token t;
+        t.line = line_;
+        t.column = static_cast<size_t>(p_ - line_start_) + 1;
+        t.data = p_;
+        if (p_ == end_) return t;
+
+        char c = *p_;
+        switch (c) {
+            case '{': return single(t, Kind::LBrace);
+            case '}': return single(t, Kind::RBrace);
+            case '[': return single(t, Kind::LBracket);
+            case ']': return single(t, Kind::RBracket);
+            case ';': return single(t, Kind::Semicolon);
+            case ',': return single(t, Kind::Comma);
+            case '=': return single(t, Kind::Equal);
+            case ':': return single(t, Kind::Colon);
+            case '+': return single(t, Kind::Plus);
+            case '"': return quoted(t);
+            case '<': return html(t);
+            default: break;
+        }
+        if (c == '-' && p_ + 1 < end_ && (p_[1] == '>' || p_[1] == '-')) {
+            t.kind = Kind::EdgeOp;
+            t.size = 2;
+            p_ += 2;
+            return t;
+        }
+        if (c == '-' || c == '.' || is_digit(c)) return numeral(t);
+        if (is_id_start(c)) {
+            while (p_ < end_ && is_id_char(*p_)) ++p_;
+            t.kind = Kind::Id;
+            t.size = static_cast<size_t>(p_ - t.data);
+            return t;
+        }
+        fail(std::string("unexpected character '") + c + "'", t.line, t.column);
+        return t;
+    }
+
+    // 引号串的值: \" 变成 ", 反斜杠加换行 (续行) 删除, 其余转义原样保留 (由 Graphviz 解释)
+    static void append_unescaped(const Token& t, std::string& out) {
+        if (t.kind != Kind::String) {
+            out.append(t.data, t.size);
+            return;
+        }
+        const char* p = t.data;
+        const char* end = t.data + t.size;
+        while (p < end) {
+            const char* bs = static_cast<const char*>(std::memchr(p, '\\', static_cast<size_t>(end - p)));
+            if (! bs) {
+                out.append(p, static_cast<size_t>(end - p));
+                break;
+            }
+            out.append(p, static_cast<size_t>(bs - p));
+            if (bs + 1 == end) {
+                out.push_back('\\');
+                break;
+            }
+            char n = bs[1];
+            if (n == '"') {
+                out.push_back('"');
+                p = bs + 2;
+            } else if (n == '\n') {
+                p = bs + 2;
+            } else if (n == '\r' && bs + 2 < end && bs[2] == '\n') {
+                p = bs + 3;
+            } else {
+                out.push_back('\\');
+                out.push_back(n);
+                p = bs + 2;
+            }
+        }
+    }
+
+    static std::string unescape(const Token& t) {
+        std::string s;
+        append_unescaped(t, s);
+        return s;
+    }
+
+    // 引号串中是否含有需要 append_unescaped 处理的反斜杠; 没有时 Token 可以直接当作值使用
+    static bool needs_unescape(const Token& t) {
+        return t.kind == Kind::String && std::memchr(t.data, '\\', t.size) != nullptr;
+    }
+
+    [[noreturn]] static void fail(const std::string& msg, size_t line, size_t column) {
+        throw DotSyntaxError(msg, line, column);
+    }
+
+  private:
+    const char* p_;
+    const char* end_;
+    const char* line_start_;
+    size_t line_ = 1;
+
+    static bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    static bool is_id_start(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (static_cast<unsigned char>(c) >= 0x80);
+    }
+
+    static bool is_id_char(char c) {
+        return is_id_start(c) || is_digit(c);
+    }
+
+    void newline() {
+        ++line_;
+        line_start_ = p_ + 1;
+    }
+
+    Token single(Token& t, Kind k) {
+        t.kind = k;
+        t.size = 1;
+        ++p_;
+        return t;
+    }
+
+    void skip_space_and_comments() {
+        while (p_ < end_) {
+            char c = *p_;
+            if (c == '\n') {
+                newline();
+                ++p_;
+            } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+                ++p_;
+            } else if (c == '#' && p_ == line_start_) {
+                while (p_ < end_ && *p_ != '\n') ++p_;
+            } else if (c == '/' && p_ + 1 < end_ && p_[1] == '/') {
+                while (p_ < end_ && *p_ != '\n') ++p_;
+            } else if (c == '/' && p_ + 1 < end_ && p_[1] == '*') {
+                size_t line = line_, column = static_cast<size_t>(p_ - line_start_) + 1;
+                p_ += 2;
+                while (p_ < end_ && ! (*p_ == '*' && p_ + 1 < end_ && p_[1] == '/')) {
+                    if (*p_ == '\n') newline();
+                    ++p_;
+                }
+                if (p_ == end_) fail("unterminated comment", line, column);
+                p_ += 2;
+            } else {
+                break;
+            }
+        }
+    }
+
+    Token quoted(Token& t) {
+        ++p_;
+        t.data = p_;
+        while (p_ < end_ && *p_ != '"') {
+            if (*p_ == '\\' && p_ + 1 < end_) {
+                if (p_[1] == '\n') newline();
+                p_ += 2;
+                continue;
+            }
+            if (*p_ == '\n') newline();
+            ++p_;
+        }
+        if (p_ == end_) fail("unterminated string", t.line, t.column);
+        t.kind = Kind::String;
+        t.size = static_cast<size_t>(p_ - t.data);
+        ++p_;
+        return t;
+    }
+
+    Token html(Token& t) {
+        ++p_;
+        t.data = p_;
+        int depth = 1;
+        while (p_ < end_) {
+            if (*p_ == '<') {
+                ++depth;
+            } else if (*p_ == '>' && --depth == 0) {
+                break;
+            } else if (*p_ == '\n') {
+                newline();
+            }
+            ++p_;
+        }
+        if (p_ == end_) fail("unterminated HTML string", t.line, t.column);
+        t.kind = Kind::Html;
+        t.size = static_cast<size_t>(p_ - t.data);
+        ++p_;
+        return t;
+    }
+
+    // [-]?(.[0-9]+ | [0-9]+(.[0-9]*)?)
+    Token numeral(Token& t) {
+        if (*p_ == '-') ++p_;
+        bool digits = false;
+        while (p_ < end_ && is_digit(*p_)) {
+            ++p_;
+            digits = true;
+        }
+        if (p_ < end_ && *p_ == '.') {
+            ++p_;
+            while (p_ < end_ && is_digit(*p_)) {
+                ++p_;
+                digits = true;
+            }
+        }
+        if (! digits) fail("malformed number", t.line, t.column);
+        t.kind = Kind::Id;
+        t.size = static_cast<size_t>(p_ - t.data);
+        return t;
+    }
+};
+
+} // namespace kgraphviz
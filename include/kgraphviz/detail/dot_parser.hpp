@@ -0,0 +1,342 @@
+#pragma once
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "dot_lexer.hpp"
+#include "mapped_file.hpp"
+#include "../graph.hpp"
+
+namespace kgraphviz {
+
+// DOT 文本 -> BaseGraph. 单遍递归下降, token 直接指向输入 (可以是 mmap 的文件), 名字和属性只在驻留时复制一次.
+// 语法错误抛出带行列号的 DotSyntaxError, 不需要启动任何进程.
+// 与 DOT 语义的对应:
+//   - "a:port:compass" 端点变成边的 tailport / headport 属性
+//   - 边的端点可以是子图, 展开为与子图中每个节点之间的边
+//   - 作用域中已有 statement 之后出现的 node [...] / edge [...] 按原位置保留为原样文本, 保持默认值的作用范围
+//   - 子图关闭 cluster 前缀 (set_cluster(false)), 名字原样保留, 匿名子图仍为匿名
+class DotParser {
+  public:
+    static BaseGraph parse(const char* data, size_t size, const std::shared_ptr<MonotonicArena>& arena = nullptr) {
+        DotParser parser(data, size);
+        return parser.run(arena);
+    }
+
+    static BaseGraph parse(const std::string& text, const std::shared_ptr<MonotonicArena>& arena = nullptr) {
+        return parse(text.data(), text.size(), arena);
+    }
+
+    // 文件通过 mmap 读入, 解析期间不在内存中保留第二份文本
+    static BaseGraph parse_file(const std::string& path, const std::shared_ptr<MonotonicArena>& arena = nullptr) {
+        MappedFile file(path);
+        return parse(file.data(), file.size(), arena);
+    }
+
+  private:
+    using Kind = DotLexer::Kind;
+    using Token = DotLexer::Token;
+    using Id = BaseGraph::Id;
+    using AttrPair = BaseGraph::AttrPair;
+    using Statement = BaseGraph::Statement;
+
+    // 边的一个端点: 单个节点 (可带端口) 或子图中的全部节点
+    struct Operand {
+        std::vector<Id> nodes; // 在当前图中驻留后的 ID
+        bool has_port = false;
+        Id port = 0;
+    };
+
+    DotLexer lex_;
+    Token tok_;
+    size_t size_;
+    bool directed_ = false;
+    std::vector<AttrPair> scratch_; // 属性列表的临时缓冲, 复用以减少分配
+
+    DotParser(const char* data, size_t size) : lex_(data, size), size_(size) {
+        advance();
+    }
+
+    void advance() {
+        tok_ = lex_.next();
+    }
+
+    [[noreturn]] void error(const std::string& msg) const {
+        DotLexer::fail(msg, tok_.line, tok_.column);
+    }
+
+    void expect(Kind k, const char* what) {
+        if (! tok_.is(k)) error(std::string("expected ") + what);
+        advance();
+    }
+
+    BaseGraph run(const std::shared_ptr<MonotonicArena>& arena) {
+        bool strict = false;
+        if (tok_.is_keyword("strict")) {
+            strict = true;
+            advance();
+        }
+        if (tok_.is_keyword("digraph")) {
+            directed_ = true;
+        } else if (! tok_.is_keyword("graph")) {
+            error("expected 'graph' or 'digraph'");
+        }
+        advance();
+
+        std::string name;
+        if (tok_.is_id()) name = value_string();
+        BaseGraph g(name, strict, directed_, arena);
+        // 按输入大小粗估规模 (一条 statement 约几十字节), 省去驻留表的多次 rehash.
+        // 估计封顶, 注释或长标签占大头的大文件不会预留过多; 超出部分照常按需增长
+        size_t estimate = std::min<size_t>(size_ / 64, 1 << 20);
+        g.reserve(estimate, estimate);
+        body(g, nullptr);
+        if (! tok_.is(Kind::End)) error("unexpected content after the closing '}'");
+        g.touch();
+        return g;
+    }
+
+    // 当前 token 作为值驻留到 g 中并前进; 引号串可以用 '+' 拼接
+    Id value(BaseGraph& g) {
+        if (! tok_.is_id()) error("expected identifier");
+        Token t = tok_;
+        advance();
+        if (t.is(Kind::Html)) {
+            // 连同尖括号一起保存并加上 HTML 标记, 输出时原样写回
+            return g.strings_.intern(IdEscaper::mark_html(t.data - 1, t.size + 2));
+        }
+        if (t.is(Kind::String) && tok_.is(Kind::Plus)) {
+            std::string s = DotLexer::unescape(t);
+            while (tok_.is(Kind::Plus)) {
+                advance();
+                if (! tok_.is(Kind::String)) error("expected string after '+'");
+                DotLexer::append_unescaped(tok_, s);
+                advance();
+            }
+            return g.strings_.intern(s);
+        }
+        if (DotLexer::needs_unescape(t)) return g.strings_.intern(DotLexer::unescape(t));
+        return g.strings_.intern(t.data, t.size);
+    }
+
+    std::string value_string() {
+        if (! tok_.is_id()) error("expected identifier");
+        Token t = tok_;
+        advance();
+        if (t.is(Kind::Html)) return IdEscaper::mark_html(t.data - 1, t.size + 2);
+        std::string s = DotLexer::unescape(t);
+        while (t.is(Kind::String) && tok_.is(Kind::Plus)) {
+            advance();
+            if (! tok_.is(Kind::String)) error("expected string after '+'");
+            DotLexer::append_unescaped(tok_, s);
+            advance();
+        }
+        return s;
+    }
+
+    // 一个或多个 [...], 结果追加到 out
+    void attr_lists(BaseGraph& g, std::vector<AttrPair>& out) {
+        while (tok_.is(Kind::LBracket)) {
+            advance();
+            while (! tok_.is(Kind::RBracket)) {
+                Id key = value(g);
+                Id val;
+                if (tok_.is(Kind::Equal)) {
+                    advance();
+                    val = value(g);
+                } else {
+                    val = g.strings_.intern("true", 4);
+                }
+                out.push_back(AttrPair{key, val});
+                if (tok_.is(Kind::Comma) || tok_.is(Kind::Semicolon)) advance();
+            }
+            advance();
+        }
+    }
+
+    // collect 非空时记录本作用域 (含嵌套子图) 出现过的节点, 用于子图作为边端点
+    void body(BaseGraph& g, std::vector<StrRef>* collect) {
+        expect(Kind::LBrace, "'{'");
+        bool seen = false; // 本作用域是否已有 node / edge / subgraph statement
+        while (! tok_.is(Kind::RBrace)) {
+            if (tok_.is(Kind::End)) error("unexpected end of input, expected '}'");
+            statement(g, collect, seen);
+            if (tok_.is(Kind::Semicolon)) advance();
+        }
+        advance();
+    }
+
+    void statement(BaseGraph& g, std::vector<StrRef>* collect, bool& seen) {
+        if (tok_.is_keyword("graph") || tok_.is_keyword("node") || tok_.is_keyword("edge")) {
+            attr_statement(g, seen);
+            return;
+        }
+
+        Operand first;
+        if (tok_.is_keyword("subgraph") || tok_.is(Kind::LBrace)) {
+            subgraph(g, collect, first);
+        } else {
+            Id id = value(g);
+            if (tok_.is(Kind::Equal)) {
+                advance();
+                std::string key = g.strings_.str(id).str();
+                g.graph_attr_.set(key, value_string());
+                return;
+            }
+            node_operand(g, id, collect, first);
+            if (! tok_.is(Kind::EdgeOp)) {
+                scratch_.clear();
+                attr_lists(g, scratch_);
+                Statement stmt = Statement::make_node(id);
+                g.append_attr_ids(stmt, scratch_);
+                g.statements_.push_back(stmt);
+                seen = true;
+                return;
+            }
+        }
+        seen = true;
+        if (tok_.is(Kind::EdgeOp)) edge_chain(g, collect, std::move(first));
+    }
+
+    void attr_statement(BaseGraph& g, bool seen) {
+        Token kw = tok_;
+        advance();
+        if (! tok_.is(Kind::LBracket)) error("expected '[' after attribute statement keyword");
+        scratch_.clear();
+        attr_lists(g, scratch_);
+
+        if (kw.is_keyword("graph")) {
+            for (const auto& kv : scratch_) {
+                g.graph_attr_.set(g.strings_.str(kv.key).str(), g.strings_.str(kv.value).str());
+            }
+            return;
+        }
+        AttrMap& defaults = kw.is_keyword("node") ? g.node_attr_ : g.edge_attr_;
+        if (! seen) {
+            for (const auto& kv : scratch_) {
+                defaults.set(g.strings_.str(kv.key).str(), g.strings_.str(kv.value).str());
+            }
+            return;
+        }
+
+        // 默认值只作用于之后出现的对象, 必须留在原来的位置
+        std::string line;
+        {
+            DotWriter out = DotWriter::to_string(line);
+            out << (kw.is_keyword("node") ? "node [" : "edge [");
+            bool first = true;
+            for (const auto& kv : scratch_) {
+                if (! first) out << ", ";
+                first = false;
+                BaseGraph::write_id(out, g.strings_.str(kv.key));
+                out.put('=');
+                BaseGraph::write_id(out, g.strings_.str(kv.value));
+            }
+            out << "];";
+        }
+        g.statements_.push_back(Statement::make_raw(g.strings_.intern(line)));
+    }
+
+    void node_operand(BaseGraph& g, Id id, std::vector<StrRef>* collect, Operand& op) {
+        op.nodes.assign(1, id);
+        if (collect) collect->push_back(g.strings_.str(id));
+        if (! tok_.is(Kind::Colon)) return;
+
+        // 端口 "port" 或 "port:compass"
+        advance();
+        std::string port = value_string();
+        if (tok_.is(Kind::Colon)) {
+            advance();
+            port += ':';
+            port += value_string();
+        }
+        op.has_port = true;
+        op.port = g.strings_.intern(port);
+    }
+
+    void subgraph(BaseGraph& g, std::vector<StrRef>* collect, Operand& op) {
+        std::string name;
+        if (tok_.is_keyword("subgraph")) {
+            advance();
+            if (tok_.is_id()) name = value_string();
+        }
+        std::shared_ptr<BaseGraph> sub = std::make_shared<BaseGraph>(name, g.strict_, g.directed_, g.arena_);
+        sub->cluster_ = false;
+
+        std::vector<StrRef> nodes;
+        body(*sub, &nodes);
+        sub->touch();
+
+        g.subgraphs_.push_back(sub);
+        g.statements_.push_back(Statement::make_subgraph(static_cast<uint32_t>(g.subgraphs_.size() - 1)));
+
+        // 子图作为边的端点时展开为其中每个节点各一次, 按首次出现的顺序
+        op.nodes.clear();
+        op.nodes.reserve(nodes.size());
+        std::unordered_set<Id> seen;
+        for (const auto& n : nodes) {
+            Id id = g.strings_.intern(n.data, n.size);
+            if (! seen.insert(id).second) continue;
+            op.nodes.push_back(id);
+            if (collect) collect->push_back(n);
+        }
+    }
+
+    void edge_chain(BaseGraph& g, std::vector<StrRef>* collect, Operand first) {
+        std::vector<Operand> ops;
+        ops.push_back(std::move(first));
+        while (tok_.is(Kind::EdgeOp)) {
+            bool arrow = tok_.data[1] == '>';
+            if (arrow != directed_) error(arrow ? "'->' in an undirected graph" : "'--' in a directed graph");
+            advance();
+
+            Operand op;
+            if (tok_.is_keyword("subgraph") || tok_.is(Kind::LBrace)) {
+                subgraph(g, collect, op);
+            } else {
+                Id id = value(g);
+                node_operand(g, id, collect, op);
+            }
+            ops.push_back(std::move(op));
+        }
+
+        scratch_.clear();
+        attr_lists(g, scratch_);
+        const size_t n_attrs = scratch_.size();
+        const Id tailport = g.strings_.intern("tailport", 8);
+        const Id headport = g.strings_.intern("headport", 8);
+
+        for (size_t i = 0; i + 1 < ops.size(); ++i) {
+            const Operand& tail = ops[i];
+            const Operand& head = ops[i + 1];
+            bool ports = tail.has_port || head.has_port;
+
+            Statement proto = Statement::make_edge(0, 0);
+            if (! ports) {
+                // 同一链上的边共用一段属性
+                std::vector<AttrPair> attrs(scratch_.begin(), scratch_.begin() + n_attrs);
+                g.append_attr_ids(proto, attrs);
+            }
+            for (Id t : tail.nodes) {
+                for (Id h : head.nodes) {
+                    Statement stmt = proto;
+                    if (ports) {
+                        std::vector<AttrPair> attrs(scratch_.begin(), scratch_.begin() + n_attrs);
+                        // 显式写在属性里的 tailport / headport 优先 (同名保留最后一个)
+                        if (tail.has_port) attrs.insert(attrs.begin(), AttrPair{tailport, tail.port});
+                        if (head.has_port) attrs.insert(attrs.begin(), AttrPair{headport, head.port});
+                        g.append_attr_ids(stmt, attrs);
+                    }
+                    stmt.a = t;
+                    stmt.b = h;
+                    g.statements_.push_back(stmt);
+                }
+            }
+        }
+    }
+};
+
+} // namespace kgraphviz
@@ -0,0 +1,121 @@
+#pragma once
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+namespace kgraphviz {
+
+const static size_t DotWriterBufferSize = 64 * 1024;
+
+// 单遍输出 DOT 文本的缓冲写入器.
+// 序列化过程只往固定大小的缓冲区里追加字节, 满了才整块交给下游 sink,
+// 因此不会为每条 statement 产生临时 std::string.
+class DotWriter {
+  public:
+    using FlushFn = std::function<void(const char* data, size_t len)>;
+
+    explicit DotWriter(FlushFn flush, size_t buffer_size = DotWriterBufferSize)
+        : flush_(std::move(flush)), buf_(buffer_size ? buffer_size : DotWriterBufferSize), pos_(0) {}
+
+    ~DotWriter() {
+        // 析构时尽力刷出剩余数据; 出错只能吞掉, 需要错误的调用方应显式 flush()
+        try {
+            flush();
+        } catch (...) {
+        }
+    }
+
+    DotWriter(const DotWriter&) = delete;
+    DotWriter& operator=(const DotWriter&) = delete;
+
+    static DotWriter to_ostream(std::ostream& os) {
+        return DotWriter([&os](const char* data, size_t len) {
+            os.write(data, static_cast<std::streamsize>(len));
+            if (! os) throw std::runtime_error("DotWriter: failed to write to ostream");
+        });
+    }
+
+    static DotWriter to_string(std::string& out) {
+        return DotWriter([&out](const char* data, size_t len) { out.append(data, len); });
+    }
+
+    static DotWriter to_fd(int fd) {
+        return DotWriter([fd](const char* data, size_t len) {
+            while (len > 0) {
+                ssize_t n = ::write(fd, data, len);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    throw std::runtime_error(std::string("DotWriter: write failed: ") + std::strerror(errno));
+                }
+                data += n;
+                len -= static_cast<size_t>(n);
+            }
+        });
+    }
+
+    DotWriter(DotWriter&& other) : flush_(std::move(other.flush_)), buf_(std::move(other.buf_)), pos_(other.pos_) {
+        other.pos_ = 0;
+    }
+
+    void write(const char* data, size_t len) {
+        if (len > buf_.size() - pos_) {
+            flush();
+            // 大块数据直接透传, 不经过缓冲区
+            if (len >= buf_.size()) {
+                flush_(data, len);
+                return;
+            }
+        }
+        std::memcpy(buf_.data() + pos_, data, len);
+        pos_ += len;
+    }
+
+    void write(const std::string& s) {
+        write(s.data(), s.size());
+    }
+
+    void put(char ch) {
+        if (pos_ == buf_.size()) flush();
+        buf_[pos_++] = ch;
+    }
+
+    void indent(int level) {
+        for (int i = 0; i < level * 4; ++i) put(' ');
+    }
+
+    DotWriter& operator<<(const char* s) {
+        write(s, std::strlen(s));
+        return *this;
+    }
+
+    DotWriter& operator<<(const std::string& s) {
+        write(s);
+        return *this;
+    }
+
+    DotWriter& operator<<(char ch) {
+        put(ch);
+        return *this;
+    }
+
+    void flush() {
+        if (pos_ > 0 && flush_) {
+            size_t n = pos_;
+            pos_ = 0;
+            flush_(buf_.data(), n);
+        }
+    }
+
+  private:
+    FlushFn flush_;
+    std::vector<char> buf_;
+    size_t pos_;
+};
+
+} // namespace kgraphviz
@@ -0,0 +1,292 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "dot_writer.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define KGRAPHVIZ_ESCAPE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace kgraphviz {
+
+enum class SimdLevel {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// DOT ID 的分类与转义, 序列化时对每个节点名、属性 key/value 调用.
+// 规则:
+//   - 由 html() 标记过的 HTML 串去掉标记后原样输出; 未标记的 "<...>" 与普通字符串一样加引号
+//   - 只含 [A-Za-z0-9_] 且不以数字开头 (纯数字除外) 且不是关键字 (不区分大小写) 时原样输出
+//   - 否则加双引号; 引号内 '"' 变成 \", 换行变成 \n, 已有的反斜杠转义 (\l, \", \\ ...) 原样保留,
+//     末尾落单的反斜杠补成 \\, 避免把结尾的引号转义掉
+// 判定与查找特殊字符按 16/32 字节一组用 SSE2/AVX2 处理, 运行时按 CPU 选择, 其他平台退回逐字节
+class IdEscaper {
+  public:
+    static void write_id(DotWriter& out, const char* data, size_t size) {
+        write_id(out, data, size, level());
+    }
+
+    // 指定实现, 供基准和对比测试使用; 不支持的级别自动降级
+    static void write_id(DotWriter& out, const char* data, size_t size, SimdLevel lvl) {
+        lvl = clamp(lvl);
+        if (size == 0) {
+            out.write("\"\"", 2);
+            return;
+        }
+        if (is_marked_html(data, size)) {
+            out.write(data + 1, size - 1);
+            return;
+        }
+        if (! needs_quotes(data, size, lvl)) {
+            out.write(data, size);
+            return;
+        }
+        write_quoted(out, data, size, lvl);
+    }
+
+    static std::string escape_id(const std::string& id) {
+        std::string result;
+        {
+            DotWriter out = DotWriter::to_string(result);
+            write_id(out, id.data(), id.size());
+        }
+        return result;
+    }
+
+    static bool needs_quotes(const char* data, size_t size, SimdLevel lvl = level()) {
+        if (size == 0) return true;
+        if (! all_word_chars(data, size, clamp(lvl))) return true;
+        if (is_digit(data[0])) {
+            // 数字开头只有纯数字才是合法的 numeral
+            for (size_t i = 1; i < size; ++i) {
+                if (! is_digit(data[i])) return true;
+            }
+            return false;
+        }
+        return is_keyword(data, size);
+    }
+
+    // HTML 串的标记: 值以该字节开头, 其后是 "<...>"
+    static char html_mark() {
+        return '\x01';
+    }
+
+    static std::string mark_html(const char* data, size_t size) {
+        std::string s(1, html_mark());
+        s.append(data, size);
+        return s;
+    }
+
+    static bool is_marked_html(const char* data, size_t size) {
+        return size > 0 && data[0] == html_mark() && is_html(data + 1, size - 1);
+    }
+
+    static bool is_html(const char* data, size_t size) {
+        if (size < 2 || data[0] != '<' || data[size - 1] != '>') return false;
+        int depth = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (data[i] == '<') {
+                ++depth;
+            } else if (data[i] == '>' && --depth == 0 && i + 1 != size) {
+                return false; // 最外层尖括号在中途就闭合了, 如 "<a> <b>"
+            }
+        }
+        return depth == 0;
+    }
+
+    // 当前 CPU 可用的最高级别, 只检测一次
+    static SimdLevel level() {
+        static const SimdLevel detected = detect();
+        return detected;
+    }
+
+  private:
+    static SimdLevel detect() {
+#if KGRAPHVIZ_ESCAPE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        return SimdLevel::SSE2;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    static SimdLevel clamp(SimdLevel lvl) {
+        SimdLevel best = level();
+        return static_cast<int>(lvl) > static_cast<int>(best) ? best : lvl;
+    }
+
+    static bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    static bool is_word(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c) || c == '_';
+    }
+
+    static bool is_special(char c) {
+        return c == '"' || c == '\\' || c == '\n';
+    }
+
+    static bool is_keyword(const char* data, size_t size) {
+        static const char* const keywords[] = {"node", "edge", "graph", "digraph", "subgraph", "strict"};
+        if (size < 4 || size > 8) return false;
+        for (const char* kw : keywords) {
+            if (std::strlen(kw) != size) continue;
+            size_t i = 0;
+            while (i < size && (data[i] | 0x20) == kw[i]) ++i;
+            if (i == size) return true;
+        }
+        return false;
+    }
+
+    static bool all_word_chars(const char* p, size_t n, SimdLevel lvl) {
+        size_t i = 0;
+#if KGRAPHVIZ_ESCAPE_X86
+        if (lvl != SimdLevel::Scalar) {
+            i = lvl == SimdLevel::AVX2 ? word_prefix_avx2(p, n) : word_prefix_sse2(p, n);
+            if (n - i >= 16) return false; // 剩余不少于一组说明向量循环在非法字符处提前停下
+        }
+#else
+        (void)lvl;
+#endif
+        for (; i < n; ++i) {
+            if (! is_word(p[i])) return false;
+        }
+        return true;
+    }
+
+    // 返回 [p, p + n) 中第一个需要转义的字符位置, 没有时返回 n
+    static size_t find_special(const char* p, size_t n, SimdLevel lvl) {
+        size_t i = 0;
+#if KGRAPHVIZ_ESCAPE_X86
+        if (lvl == SimdLevel::AVX2) {
+            i = special_scan_avx2(p, n);
+        } else if (lvl == SimdLevel::SSE2) {
+            i = special_scan_sse2(p, n);
+        }
+#else
+        (void)lvl;
+#endif
+        for (; i < n; ++i) {
+            if (is_special(p[i])) return i;
+        }
+        return n;
+    }
+
+    static void write_quoted(DotWriter& out, const char* p, size_t n, SimdLevel lvl) {
+        out.put('"');
+        size_t i = 0;
+        while (i < n) {
+            size_t run = find_special(p + i, n - i, lvl);
+            out.write(p + i, run);
+            i += run;
+            if (i == n) break;
+
+            char c = p[i];
+            if (c == '\\') {
+                if (i + 1 < n) {
+                    // 已有的转义序列原样保留 (\l \r \n \" \\ ...)
+                    out.put('\\');
+                    out.put(p[i + 1]);
+                    i += 2;
+                } else {
+                    out.write("\\\\", 2);
+                    i += 1;
+                }
+            } else if (c == '"') {
+                out.write("\\\"", 2);
+                i += 1;
+            } else { // '\n'
+                out.write("\\n", 2);
+                i += 1;
+            }
+        }
+        out.put('"');
+    }
+
+#if KGRAPHVIZ_ESCAPE_X86
+    // 有符号比较: >= 0x80 的字节为负数, 自然落在所有区间之外
+    static __m128i word_mask_sse2(__m128i v) {
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                      _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                      _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)),
+                                      _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+        __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+        return _mm_or_si128(_mm_or_si128(digit, upper), _mm_or_si128(lower, under));
+    }
+
+    // 整组都是单词字符时前进, 返回停下的位置 (剩余不足 16 字节或遇到非法字符)
+    static size_t word_prefix_sse2(const char* p, size_t n) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            if (_mm_movemask_epi8(word_mask_sse2(v)) != 0xffff) return i;
+        }
+        return i;
+    }
+
+    static size_t special_scan_sse2(const char* p, size_t n) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                                    _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+                                       _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+            int mask = _mm_movemask_epi8(hit);
+            if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) static __m256i word_mask_avx2(__m256i v) {
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), v));
+        __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('a' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), v));
+        __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+        return _mm256_or_si256(_mm256_or_si256(digit, upper), _mm256_or_si256(lower, under));
+    }
+
+    __attribute__((target("avx2"))) static size_t word_prefix_avx2(const char* p, size_t n) {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            if (static_cast<unsigned>(_mm256_movemask_epi8(word_mask_avx2(v))) != 0xffffffffu) return i;
+        }
+        // 剩余部分交给 SSE2
+        return i + word_prefix_sse2(p + i, n - i);
+    }
+
+    __attribute__((target("avx2"))) static size_t special_scan_avx2(const char* p, size_t n) {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                                          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+                                          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+            if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(mask));
+        }
+        return i + special_scan_sse2(p + i, n - i);
+    }
+#endif
+};
+
+// 把 markup 作为 HTML 串 (label=<...>) 使用, 如 html("<b>bold</b>"); 其他值一律按普通字符串加引号
+inline std::string html(const std::string& markup) {
+    std::string s = "<" + markup + ">";
+    return IdEscaper::mark_html(s.data(), s.size());
+}
+
+} // namespace kgraphviz
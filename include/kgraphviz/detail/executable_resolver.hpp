@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace kgraphviz {
+
+// 在进程内按 PATH 查找可执行文件并缓存绝对路径, 取代每次渲染前 `command -v` 的 shell 调用.
+// 缓存以 (名字, 当前 PATH) 为键, PATH 改变后自动重新查找; 安装/删除 engine 后可调用 invalidate()
+class ExecutableResolver {
+  public:
+    // 返回可执行文件路径, 找不到时返回空串. 含 '/' 的名字只检查其本身
+    static std::string resolve(const std::string& name) {
+        if (name.empty()) return "";
+        if (name.find('/') != std::string::npos) {
+            return is_executable_file(name) ? name : "";
+        }
+
+        const char* path_env = std::getenv("PATH");
+        std::string path = path_env ? path_env : "/usr/local/bin:/usr/bin:/bin";
+        std::string key = name + '\0' + path;
+
+        State& st = state();
+        {
+            std::lock_guard<std::mutex> lock(st.mutex);
+            auto it = st.cache.find(key);
+            if (it != st.cache.end()) return it->second;
+        }
+
+        std::string found = search(name, path);
+        if (! found.empty()) {
+            // 只缓存找到的结果, 之后安装的 engine 不需要手动 invalidate 也能被发现
+            std::lock_guard<std::mutex> lock(st.mutex);
+            st.cache[key] = found;
+        }
+        return found;
+    }
+
+    static void invalidate() {
+        State& st = state();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        st.cache.clear();
+    }
+
+    static void invalidate(const std::string& name) {
+        State& st = state();
+        std::lock_guard<std::mutex> lock(st.mutex);
+        for (auto it = st.cache.begin(); it != st.cache.end();) {
+            if (it->first.compare(0, name.size() + 1, name + '\0') == 0) {
+                it = st.cache.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+  private:
+    struct State {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::string> cache;
+    };
+
+    static State& state() {
+        static State st;
+        return st;
+    }
+
+    static bool is_executable_file(const std::string& file) {
+        struct stat sb;
+        return ::stat(file.c_str(), &sb) == 0 && S_ISREG(sb.st_mode) && ::access(file.c_str(), X_OK) == 0;
+    }
+
+    static std::string search(const std::string& name, const std::string& path) {
+        size_t begin = 0;
+        for (;;) {
+            size_t end = path.find(':', begin);
+            std::string dir = path.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+            if (dir.empty()) dir = "."; // 空项表示当前目录, 与 shell 一致
+
+            std::string candidate = dir + "/" + name;
+            if (is_executable_file(candidate)) return candidate;
+
+            if (end == std::string::npos) break;
+            begin = end + 1;
+        }
+        return "";
+    }
+};
+
+} // namespace kgraphviz
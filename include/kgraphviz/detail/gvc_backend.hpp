@@ -0,0 +1,423 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef KGRAPHVIZ_WITH_GVC
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <graphviz/gvc.h>
+#include <graphviz/cgraph.h>
+#endif
+
+#include "escape.hpp"
+#include "render.hpp"
+#include "string_interner.hpp"
+#include "../exceptions.hpp"
+#include "../options.hpp"
+
+namespace kgraphviz {
+
+#ifdef KGRAPHVIZ_WITH_GVC
+
+// 进程内共享的 GVC_t. libgvc 内部有全局状态且不是线程安全的, 所有调用都在 mutex() 下串行执行
+class GvcContext {
+  public:
+    static GVC_t* get() {
+        static Holder holder;
+        return holder.gvc;
+    }
+
+    static std::mutex& mutex() {
+        static std::mutex m;
+        return m;
+    }
+
+    // agseterrf 回调收集的错误信息, 只在持有 mutex() 时访问
+    static std::string& errors() {
+        static std::string e;
+        return e;
+    }
+
+    // agusererrf 在不同 Graphviz 版本里参数是 char* 或 const char*, 两个重载按目标类型选择
+    static int collect_error(char* msg) {
+        errors() += msg;
+        return 0;
+    }
+
+    static int collect_error(const char* msg) {
+        errors() += msg;
+        return 0;
+    }
+
+  private:
+    struct Holder {
+        GVC_t* gvc;
+        Holder() : gvc(gvContext()) {}
+        ~Holder() {
+            gvFreeContext(gvc);
+        }
+    };
+};
+
+class GvcRenderer {
+  public:
+    // 从 BaseGraph 的 statements 直接构造 cgraph, 不经过 DOT 文本
+    template <typename GraphT>
+    static std::vector<uint8_t> render_graph(const GraphT& graph, const RenderOptions& options) {
+        std::lock_guard<std::mutex> lock(GvcContext::mutex());
+        Session session;
+        session.g = build(graph);
+        return session.render_data(options);
+    }
+
+    template <typename GraphT>
+    static void render_graph(const GraphT& graph, const std::string& output_file, RenderOptions options) {
+        Renderer::deduce_format(output_file, options);
+        std::lock_guard<std::mutex> lock(GvcContext::mutex());
+        Session session;
+        session.g = build(graph);
+        session.render_file(output_file, options);
+    }
+
+    static std::vector<uint8_t> render_source(const std::string& dot_source, const RenderOptions& options) {
+        std::lock_guard<std::mutex> lock(GvcContext::mutex());
+        Session session;
+        session.g = parse(dot_source);
+        return session.render_data(options);
+    }
+
+    static void render_source(const std::string& dot_source, const std::string& output_file, RenderOptions options) {
+        Renderer::deduce_format(output_file, options);
+        std::lock_guard<std::mutex> lock(GvcContext::mutex());
+        Session session;
+        session.g = parse(dot_source);
+        session.render_file(output_file, options);
+    }
+
+    // options.outputs 的全部格式共用一次 gvLayout
+    template <typename GraphT>
+    static RenderResults render_graph_outputs(const GraphT& graph, const RenderOptions& options) {
+        std::lock_guard<std::mutex> lock(GvcContext::mutex());
+        Session session;
+        session.g = build(graph);
+        return session.render_outputs(options);
+    }
+
+    static RenderResults render_source_outputs(const std::string& dot_source, const RenderOptions& options) {
+        std::lock_guard<std::mutex> lock(GvcContext::mutex());
+        Session session;
+        session.g = parse(dot_source);
+        return session.render_outputs(options);
+    }
+
+  private:
+    // 一次渲染的 graph 生命周期; 析构时释放 layout 与 graph, 并恢复宿主程序原来的 cgraph 错误处理函数
+    struct Session {
+        Agraph_t* g = nullptr;
+        bool laid_out = false;
+        agusererrf previous_errf = nullptr;
+
+        Session() {
+            GvcContext::errors().clear();
+            previous_errf = agseterrf(&GvcContext::collect_error);
+        }
+
+        ~Session() {
+            if (g) {
+                if (laid_out) gvFreeLayout(GvcContext::get(), g);
+                agclose(g);
+            }
+            agseterrf(previous_errf);
+        }
+
+        void layout(const RenderOptions& options) {
+            std::string engine = engine_name(options);
+            if (gvLayout(GvcContext::get(), g, engine.c_str()) != 0) {
+                throw CalledProcessError(1, "gvLayout(" + engine + ")", "", options.quiet ? "" : GvcContext::errors());
+            }
+            laid_out = true;
+        }
+
+        std::vector<uint8_t> render_data(const RenderOptions& options) {
+            if (options.format.empty()) {
+                throw RequiredArgumentError("format");
+            }
+            layout(options);
+            return data(format_spec(options), options);
+        }
+
+        void render_file(const std::string& output_file, const RenderOptions& options) {
+            layout(options);
+            file(format_spec(options), output_file, options);
+        }
+
+        RenderResults render_outputs(const RenderOptions& options) {
+            if (options.outputs.empty()) {
+                throw RequiredArgumentError("outputs (required by render_outputs)");
+            }
+            layout(options);
+
+            RenderResults results;
+            for (const auto& output : options.outputs) {
+                std::string fmt = Renderer::output_format(output);
+                if (output.path.empty()) {
+                    if (! results.count(fmt)) results[fmt] = data(fmt, options);
+                    continue;
+                }
+                if (options.raise_if_result_exists) {
+                    std::ifstream check(output.path.c_str());
+                    if (check.good()) throw FileExistsError(output.path);
+                }
+                file(fmt, output.path, options);
+            }
+            return results;
+        }
+
+        std::vector<uint8_t> data(const std::string& fmt, const RenderOptions& options) {
+            char* buf = nullptr;
+            std::vector<uint8_t> out;
+            if (call_render_data(&gvRenderData, g, fmt, &buf, out) != 0) {
+                if (buf) gvFreeRenderData(buf);
+                throw CalledProcessError(1, "gvRenderData(" + fmt + ")", "", options.quiet ? "" : GvcContext::errors());
+            }
+            gvFreeRenderData(buf);
+            return out;
+        }
+
+        void file(const std::string& fmt, const std::string& output_file, const RenderOptions& options) {
+            if (gvRenderFilename(GvcContext::get(), g, fmt.c_str(), output_file.c_str()) != 0) {
+                throw CalledProcessError(
+                    1, "gvRenderFilename(" + fmt + ")", "", options.quiet ? "" : GvcContext::errors());
+            }
+        }
+    };
+
+    // gvRenderData 的长度参数在不同 Graphviz 版本里是 unsigned int* 或 size_t*, 这里用模板推导
+    template <typename G, typename Fmt, typename Len>
+    static int call_render_data(int (*fn)(GVC_t*, G*, Fmt, char**, Len*),
+                                Agraph_t* g,
+                                const std::string& fmt,
+                                char** data,
+                                std::vector<uint8_t>& out) {
+        Len len = 0;
+        int rc = fn(GvcContext::get(), g, cstr(fmt), data, &len);
+        if (rc == 0 && *data) {
+            out.assign(reinterpret_cast<const uint8_t*>(*data), reinterpret_cast<const uint8_t*>(*data) + len);
+        }
+        return rc;
+    }
+
+    static std::string engine_name(const RenderOptions& options) {
+        // "nop" / "nop2" 等价于 neato -n / -n2: 使用已有的 pos 属性, 跳过布局
+        if (options.neato_no_op) return options.neato_no_op_level > 1 ? "nop2" : "nop";
+
+        std::string engine = options.engine;
+        auto slash = engine.find_last_of("/\\");
+        if (slash != std::string::npos) engine = engine.substr(slash + 1);
+        if (engine.size() > 4 && engine.compare(engine.size() - 4, 4, ".exe") == 0) {
+            engine.resize(engine.size() - 4);
+        }
+        return engine;
+    }
+
+    static std::string format_spec(const RenderOptions& options) {
+        std::string fmt = options.format;
+        if (! options.renderer.empty()) {
+            fmt += ":" + options.renderer;
+            if (! options.formatter.empty()) fmt += ":" + options.formatter;
+        }
+        return fmt;
+    }
+
+    static char* cstr(const std::string& s) {
+        return const_cast<char*>(s.c_str());
+    }
+
+    // 驻留串以 '\0' 结尾
+    static char* cstr(StrRef s) {
+        return const_cast<char*>(s.c_str());
+    }
+
+    static Agraph_t* parse(const std::string& dot_source) {
+        Agraph_t* g = agmemread(dot_source.c_str());
+        if (! g) {
+            throw CalledProcessError(1, "agmemread", "", GvcContext::errors());
+        }
+        return g;
+    }
+
+    template <typename GraphT>
+    static Agraph_t* build(const GraphT& graph) {
+        if (graph.has_raw_lines()) {
+            // 原样文本行无法映射到 cgraph 对象, 退回到解析序列化结果
+            return parse(graph.to_string());
+        }
+
+        Agdesc_t desc = graph.is_directed() ? (graph.is_strict() ? Agstrictdirected : Agdirected) :
+                                              (graph.is_strict() ? Agstrictundirected : Agundirected);
+        Agraph_t* root = agopen(cstr(graph.name()), desc, nullptr);
+        if (! root) {
+            throw CalledProcessError(1, "agopen", "", GvcContext::errors());
+        }
+
+        try {
+            Builder builder(root, root);
+            builder.apply_defaults(graph);
+            graph.visit(builder);
+        } catch (...) {
+            agclose(root);
+            throw;
+        }
+        return root;
+    }
+
+    // BaseGraph::visit 的访问者, 把每条 statement 变成对应的 cgraph 对象
+    struct Builder {
+        Agraph_t* root;
+        Agraph_t* g;
+
+        Builder(Agraph_t* root_, Agraph_t* g_) : root(root_), g(g_) {}
+
+        template <typename GraphT>
+        void apply_defaults(const GraphT& graph) {
+            for (const auto& kv : graph.graph_attr()) {
+                Value v(root, kv.second);
+                agsafeset(g, cstr(kv.first), v.get(), cstr(empty()));
+            }
+            for (const auto& kv : graph.node_attr()) {
+                declare(AGNODE, kv.first);
+                Value v(root, kv.second);
+                agattr(g, AGNODE, cstr(kv.first), v.get());
+            }
+            for (const auto& kv : graph.edge_attr()) {
+                declare(AGEDGE, kv.first);
+                Value v(root, kv.second);
+                agattr(g, AGEDGE, cstr(kv.first), v.get());
+            }
+        }
+
+        void raw(StrRef) {
+            // has_raw_lines() 已经走了文本路径, 不会到达这里
+        }
+
+        template <typename Attrs>
+        void node(StrRef name, const Attrs& attrs) {
+            Agnode_t* n = agnode(g, cstr(name), 1);
+            set_attrs(AGNODE, n, attrs);
+        }
+
+        template <typename Attrs>
+        void edge(StrRef tail, StrRef head, const Attrs& attrs) {
+            Agnode_t* t = agnode(g, cstr(tail), 1);
+            Agnode_t* h = agnode(g, cstr(head), 1);
+            Agedge_t* e = agedge(g, t, h, nullptr, 1);
+            if (e) set_attrs(AGEDGE, e, attrs);
+        }
+
+        template <typename GraphT>
+        void subgraph(const GraphT& sub) {
+            std::string id = sub.subgraph_id();
+            Agraph_t* sg = agsubg(g, id.empty() ? nullptr : cstr(id), 1); // 空名字为匿名子图
+            Builder child(root, sg);
+            child.apply_defaults(sub);
+            sub.visit(child);
+        }
+
+      private:
+        // html() 标记过的值去掉标记和外层尖括号, 用 agstrdup_html 登记; cgraph 复制属性值时保留 HTML 属性
+        class Value {
+          public:
+            template <typename Str>
+            Value(Agraph_t* g, const Str& s) : g_(g), plain_(cstr(s)), html_(nullptr) {
+                const char* p = cstr(s);
+                size_t n = std::strlen(p);
+                if (IdEscaper::is_marked_html(p, n)) html_ = agstrdup_html(g_, cstr(std::string(p + 2, n - 3)));
+            }
+
+            Value(const Value&) = delete;
+            Value& operator=(const Value&) = delete;
+
+            ~Value() {
+                if (html_) agstrfree(g_, html_);
+            }
+
+            char* get() const {
+                return html_ ? html_ : plain_;
+            }
+
+          private:
+            Agraph_t* g_;
+            char* plain_;
+            char* html_;
+        };
+
+        static const std::string& empty() {
+            static const std::string e;
+            return e;
+        }
+
+        // 属性必须先在 root 上声明 (默认值为空), 子图和对象才能设置它
+        template <typename Str>
+        void declare(int kind, const Str& key) {
+            if (! agattr(root, kind, cstr(key), nullptr)) {
+                agattr(root, kind, cstr(key), cstr(empty()));
+            }
+        }
+
+        template <typename Attrs>
+        void set_attrs(int kind, void* obj, const Attrs& attrs) {
+            for (const auto& kv : attrs) {
+                declare(kind, kv.first);
+                Value v(root, kv.second);
+                agset(obj, cstr(kv.first), v.get());
+            }
+        }
+    };
+};
+
+#else // ! KGRAPHVIZ_WITH_GVC
+
+class GvcRenderer {
+  public:
+    template <typename GraphT>
+    static std::vector<uint8_t> render_graph(const GraphT&, const RenderOptions&) {
+        unavailable();
+        return {};
+    }
+
+    template <typename GraphT>
+    static void render_graph(const GraphT&, const std::string&, const RenderOptions&) {
+        unavailable();
+    }
+
+    static std::vector<uint8_t> render_source(const std::string&, const RenderOptions&) {
+        unavailable();
+        return {};
+    }
+
+    static void render_source(const std::string&, const std::string&, const RenderOptions&) {
+        unavailable();
+    }
+
+    template <typename GraphT>
+    static RenderResults render_graph_outputs(const GraphT&, const RenderOptions&) {
+        unavailable();
+        return {};
+    }
+
+    static RenderResults render_source_outputs(const std::string&, const RenderOptions&) {
+        unavailable();
+        return {};
+    }
+
+  private:
+    static void unavailable() {
+        throw BackendNotAvailable("RenderBackend::InProcess requires building with -DKGRAPHVIZ_WITH_GVC");
+    }
+};
+
+#endif
+
+} // namespace kgraphviz
@@ -0,0 +1,295 @@
+#pragma once
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "attr_map.hpp"
+#include "dot_lexer.hpp"
+
+namespace kgraphviz {
+
+// 一次布局的结果: 从 engine 的 -Tdot / -Txdot 输出中只保留坐标相关的属性
+// (节点 pos / width / height / xlp, 边 pos / lp / xlp / head_lp / tail_lp, 根图与具名子图 bb / lp / lwidth / lheight).
+// 由 BaseGraph::layout() 生成, 再交给 BaseGraph::render(const Layout&, ...) 用 neato -n2 跳过布局重新渲染
+class Layout {
+  public:
+    struct Point {
+        double x = 0;
+        double y = 0;
+    };
+
+    static Layout parse(const std::string& dot_text) {
+        return parse(dot_text.data(), dot_text.size());
+    }
+
+    static Layout parse(const char* data, size_t size) {
+        Layout layout;
+        Parser(data, size, layout).run();
+        return layout;
+    }
+
+    bool directed() const {
+        return directed_;
+    }
+
+    bool empty() const {
+        return nodes_.empty();
+    }
+
+    size_t node_count() const {
+        return nodes_.size();
+    }
+
+    size_t edge_count() const {
+        return edge_count_;
+    }
+
+    const AttrMap& graph_attrs() const {
+        return graph_;
+    }
+
+    // 按输出中的子图名 (cluster 带 "cluster_" 前缀, 见 BaseGraph::subgraph_id()); 匿名子图没有记录
+    const AttrMap* subgraph_attrs(const std::string& name) const {
+        auto it = subgraphs_.find(name);
+        return it == subgraphs_.end() ? nullptr : &it->second;
+    }
+
+    // 按在输出中首次出现的顺序
+    const std::vector<std::pair<std::string, AttrMap>>& nodes() const {
+        return nodes_;
+    }
+
+    const AttrMap* node_attrs(const std::string& name) const {
+        auto it = node_index_.find(name);
+        return it == node_index_.end() ? nullptr : &nodes_[it->second].second;
+    }
+
+    // 第 index 条 tail -> head 的边 (同一对节点之间的多重边按出现顺序编号); 无向图与端点顺序无关
+    const AttrMap* edge_attrs(const std::string& tail, const std::string& head, size_t index = 0) const {
+        auto it = edges_.find(edge_key(tail, head));
+        if (it == edges_.end() || index >= it->second.size()) return nullptr;
+        return &it->second[index];
+    }
+
+    // 节点中心坐标 (单位 point)
+    bool node_pos(const std::string& name, Point& p) const {
+        const AttrMap* attrs = node_attrs(name);
+        if (! attrs) return false;
+        auto it = attrs->find("pos");
+        if (it == attrs->end()) return false;
+        const char* s = it->second.c_str();
+        char* end = nullptr;
+        p.x = std::strtod(s, &end);
+        if (end == s || *end != ',') return false;
+        p.y = std::strtod(end + 1, nullptr);
+        return true;
+    }
+
+    // 按 engine 路径推出同目录下的 neato (dot -> neato, /opt/gv/bin/dot -> /opt/gv/bin/neato)
+    static std::string neato_engine(const std::string& engine) {
+        return sibling_tool(engine, "neato");
+    }
+
+    // 与 engine 同目录的另一个 Graphviz 工具 (neato, gvpack ...), 保留 .exe 后缀
+    static std::string sibling_tool(const std::string& engine, const std::string& tool) {
+        auto slash = engine.find_last_of("/\\");
+        std::string dir = slash == std::string::npos ? "" : engine.substr(0, slash + 1);
+        std::string name = slash == std::string::npos ? engine : engine.substr(slash + 1);
+        bool exe = name.size() > 4 && name.compare(name.size() - 4, 4, ".exe") == 0;
+        return dir + tool + (exe ? ".exe" : "");
+    }
+
+  private:
+    bool directed_ = false;
+    AttrMap graph_;
+    std::unordered_map<std::string, AttrMap> subgraphs_;
+    std::vector<std::pair<std::string, AttrMap>> nodes_;
+    std::unordered_map<std::string, size_t> node_index_;
+    std::map<std::pair<std::string, std::string>, std::vector<AttrMap>> edges_;
+    size_t edge_count_ = 0;
+
+    std::pair<std::string, std::string> edge_key(const std::string& tail, const std::string& head) const {
+        if (! directed_ && head < tail) return std::make_pair(head, tail);
+        return std::make_pair(tail, head);
+    }
+
+    static bool is_node_key(const std::string& k) {
+        return k == "pos" || k == "width" || k == "height" || k == "xlp";
+    }
+
+    static bool is_edge_key(const std::string& k) {
+        return k == "pos" || k == "lp" || k == "xlp" || k == "head_lp" || k == "tail_lp";
+    }
+
+    static bool is_graph_key(const std::string& k) {
+        return k == "bb" || k == "lp" || k == "lwidth" || k == "lheight";
+    }
+
+    AttrMap& node_slot(const std::string& name) {
+        auto it = node_index_.find(name);
+        if (it != node_index_.end()) return nodes_[it->second].second;
+        node_index_.emplace(name, nodes_.size());
+        nodes_.push_back(std::make_pair(name, AttrMap()));
+        return nodes_.back().second;
+    }
+
+    // 只处理 engine 输出的 DOT 子集: 边的端点必须是节点 (不能是子图)
+    class Parser {
+      public:
+        Parser(const char* data, size_t size, Layout& layout) : lex_(data, size), layout_(layout) {
+            tok_ = lex_.next();
+        }
+
+        void run() {
+            if (tok_.is_keyword("strict")) advance();
+            if (tok_.is_keyword("digraph")) {
+                layout_.directed_ = true;
+            } else if (! tok_.is_keyword("graph")) {
+                error("expected 'graph' or 'digraph'");
+            }
+            advance();
+            if (tok_.is_id()) advance();
+            body(&layout_.graph_);
+            if (! tok_.is(DotLexer::Kind::End)) error("unexpected content after graph");
+        }
+
+      private:
+        DotLexer lex_;
+        DotLexer::Token tok_;
+        Layout& layout_;
+
+        void advance() {
+            tok_ = lex_.next();
+        }
+
+        [[noreturn]] void error(const std::string& msg) {
+            DotLexer::fail(msg, tok_.line, tok_.column);
+        }
+
+        void expect(DotLexer::Kind k, const char* what) {
+            if (! tok_.is(k)) error(std::string("expected ") + what);
+            advance();
+        }
+
+        // ID, 引号串可以用 '+' 拼接
+        std::string id() {
+            if (! tok_.is_id()) error("expected identifier");
+            std::string s = DotLexer::unescape(tok_);
+            bool quoted = tok_.is(DotLexer::Kind::String);
+            advance();
+            while (quoted && tok_.is(DotLexer::Kind::Plus)) {
+                advance();
+                if (! tok_.is(DotLexer::Kind::String)) error("expected string after '+'");
+                DotLexer::append_unescaped(tok_, s);
+                advance();
+            }
+            return s;
+        }
+
+        // 节点名, 忽略 :port:compass
+        std::string node_id() {
+            std::string name = id();
+            for (int i = 0; i < 2 && tok_.is(DotLexer::Kind::Colon); ++i) {
+                advance();
+                id();
+            }
+            return name;
+        }
+
+        // graph 为当前 (子) 图的属性记录位置, 匿名子图为 nullptr
+        void body(AttrMap* graph) {
+            expect(DotLexer::Kind::LBrace, "'{'");
+            while (! tok_.is(DotLexer::Kind::RBrace)) {
+                if (tok_.is(DotLexer::Kind::End)) error("unexpected end of input, expected '}'");
+                statement(graph);
+                if (tok_.is(DotLexer::Kind::Semicolon)) advance();
+            }
+            advance();
+        }
+
+        void statement(AttrMap* graph) {
+            if (tok_.is_keyword("graph")) {
+                advance();
+                AttrMap attrs;
+                attr_lists(attrs);
+                if (graph) keep(attrs, *graph, &Layout::is_graph_key);
+                return;
+            }
+            if (tok_.is_keyword("node") || tok_.is_keyword("edge")) {
+                advance();
+                AttrMap ignored;
+                attr_lists(ignored);
+                return;
+            }
+            if (tok_.is_keyword("subgraph") || tok_.is(DotLexer::Kind::LBrace)) {
+                AttrMap* sub = nullptr;
+                if (tok_.is_keyword("subgraph")) {
+                    advance();
+                    if (tok_.is_id()) sub = &layout_.subgraphs_[id()];
+                }
+                body(sub);
+                return;
+            }
+
+            std::string first = node_id();
+            if (tok_.is(DotLexer::Kind::Equal)) {
+                advance();
+                std::string value = id();
+                if (graph && Layout::is_graph_key(first)) graph->set(first, value);
+                return;
+            }
+
+            std::vector<std::string> chain(1, first);
+            while (tok_.is(DotLexer::Kind::EdgeOp)) {
+                advance();
+                if (tok_.is_keyword("subgraph") || tok_.is(DotLexer::Kind::LBrace)) {
+                    error("subgraph edge operands are not supported in layout output");
+                }
+                chain.push_back(node_id());
+            }
+
+            AttrMap attrs;
+            attr_lists(attrs);
+            if (chain.size() == 1) {
+                keep(attrs, layout_.node_slot(first), &Layout::is_node_key);
+                return;
+            }
+            for (size_t i = 0; i + 1 < chain.size(); ++i) {
+                layout_.node_slot(chain[i]);
+                layout_.node_slot(chain[i + 1]);
+                AttrMap kept;
+                keep(attrs, kept, &Layout::is_edge_key);
+                layout_.edges_[layout_.edge_key(chain[i], chain[i + 1])].push_back(std::move(kept));
+                ++layout_.edge_count_;
+            }
+        }
+
+        void attr_lists(AttrMap& attrs) {
+            while (tok_.is(DotLexer::Kind::LBracket)) {
+                advance();
+                while (! tok_.is(DotLexer::Kind::RBracket)) {
+                    std::string key = id();
+                    std::string value = "true";
+                    if (tok_.is(DotLexer::Kind::Equal)) {
+                        advance();
+                        value = id();
+                    }
+                    attrs.set(key, value);
+                    if (tok_.is(DotLexer::Kind::Comma) || tok_.is(DotLexer::Kind::Semicolon)) advance();
+                }
+                advance();
+            }
+        }
+
+        static void keep(const AttrMap& from, AttrMap& to, bool (*wanted)(const std::string&)) {
+            for (const auto& kv : from) {
+                if (wanted(kv.first)) to.set(kv.first, kv.second);
+            }
+        }
+    };
+};
+
+} // namespace kgraphviz
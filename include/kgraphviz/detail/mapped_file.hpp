@@ -0,0 +1,83 @@
+#pragma once
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../exceptions.hpp"
+
+namespace kgraphviz {
+
+// 只读映射整个文件, 供解析大文件时按需分页读入而不是先复制到内存. 空文件不映射, data() 为 nullptr
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT) throw FileNotExistsError(path);
+            throw std::runtime_error("Failed to open file: " + path + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int err = errno;
+            ::close(fd);
+            throw std::runtime_error("Failed to stat file: " + path + ": " + std::strerror(err));
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        dev_ = st.st_dev;
+        ino_ = st.st_ino;
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                int err = errno;
+                ::close(fd);
+                throw std::runtime_error("Failed to map file: " + path + ": " + std::strerror(err));
+            }
+#ifdef MADV_SEQUENTIAL
+            ::madvise(p, size_, MADV_SEQUENTIAL); // 只做一遍顺序扫描, 让内核积极预读
+#endif
+            data_ = static_cast<const char*>(p);
+        }
+        ::close(fd); // 映射建立后不再需要 fd
+    }
+
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : data_(other.data_), size_(other.size_), dev_(other.dev_), ino_(other.ino_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    // path 是否就是映射的这个文件 (按 device + inode 比较, 不受路径写法和链接影响)
+    bool is_same_file(const std::string& path) const {
+        struct stat st;
+        return ::stat(path.c_str(), &st) == 0 && st.st_dev == dev_ && st.st_ino == ino_;
+    }
+
+  private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    dev_t dev_ = 0;
+    ino_t ino_ = 0;
+};
+
+} // namespace kgraphviz
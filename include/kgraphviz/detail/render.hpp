@@ -1,50 +1,56 @@
 #pragma once
 #include <cstdint>
+#include <functional>
 #include <string>
-#include <string>
-#include <sstream>
 #include <fstream>
+#include <cstdio>
 #include <cstdlib>
+#include <iterator>
+#include <map>
+#include <utility>
 #include <vector>
+#include "executable_resolver.hpp"
+#include "layout.hpp"
 #include "run_command.hpp"
+#include "tmpfile.hpp"
 
 #include "../exceptions.hpp"
 #include "../options.hpp"
 
 namespace kgraphviz {
 
+// 按需把 DOT 文本写入 DotWriter 的生产者, 用于边序列化边喂给引擎
+using DotProducer = std::function<void(DotWriter&)>;
+
+// render_outputs() 的内存结果: format -> 字节
+using RenderResults = std::map<std::string, std::vector<uint8_t>>;
+
 class Renderer {
   public:
     static void
     render(const std::string& input_file, const std::string& output_file, RenderOptions options = RenderOptions()) {
-        validate_options(options, input_file, output_file);
+        std::string exe = validate_options(options, input_file, output_file);
 
         std::string fmt = deduce_format(output_file, options);
 
-        std::ostringstream cmd = build_command(input_file, output_file, options, /*to_stdout=*/false);
-        std::string full_cmd = cmd.str();
+        std::vector<std::string> argv = build_argv(exe, input_file, output_file, options, /*to_stdout=*/false);
 
         std::string stdout_output, stderr_output;
-        int exit_code = run_command(full_cmd, stdout_output, stderr_output);
-        if (exit_code != 0) {
-            throw CalledProcessError(exit_code, full_cmd, stdout_output, options.quiet ? "" : stderr_output);
-        }
+        int exit_code = run_command(argv, stdout_output, stderr_output, limits_of(options));
+        check_exit(exit_code, argv, stdout_output, stderr_output, options);
     }
 
     // render_to_memory 必须在 options 中指定 format, 否则不知道推断为什么格式
     static std::vector<uint8_t> render_to_memory(const std::string& input_file,
                                                  const RenderOptions& options = RenderOptions()) {
-        validate_options(options, input_file, /*output_file*/ "");
+        std::string exe = validate_options(options, input_file, /*output_file*/ "");
 
-        std::ostringstream cmd = build_command(input_file, "", options, /*to_stdout=*/true);
-        std::string full_cmd = cmd.str();
+        std::vector<std::string> argv = build_argv(exe, input_file, "", options, /*to_stdout=*/true);
 
         std::vector<uint8_t> binary_output;
         std::string stderr_output;
-        int exit_code = run_command(full_cmd, binary_output, stderr_output);
-        if (exit_code != 0) {
-            throw CalledProcessError(exit_code, full_cmd, "<ignored>", options.quiet ? "" : stderr_output);
-        }
+        int exit_code = run_command(argv, binary_output, stderr_output, limits_of(options));
+        check_exit(exit_code, argv, "<ignored>", stderr_output, options);
 
         return binary_output;
     }
@@ -53,7 +59,7 @@ class Renderer {
     static void render_from_string(const std::string& dot_source,
                                    const std::string& output_file,
                                    RenderOptions options = RenderOptions()) {
-        validate_options(options, /*input_file*/ "", output_file);
+        std::string exe = validate_options(options, /*input_file*/ "", output_file);
 
         if (output_file.empty()) {
             throw RequiredArgumentError("output_file (required)");
@@ -61,7 +67,8 @@ class Renderer {
 
         std::string fmt = deduce_format(output_file, options);
 
-        std::ostringstream cmd = build_command(
+        std::vector<std::string> argv = build_argv(
+            exe,
             /*input_file*/ "",
             output_file,
             options,
@@ -71,18 +78,17 @@ class Renderer {
 
         std::vector<uint8_t> ignored;
         std::string stderr_output;
-        int code = run_command_with_stdin(dot_source, cmd.str(), ignored, stderr_output);
-        if (code != 0) {
-            throw CalledProcessError(code, cmd.str(), "<ignored>", options.quiet ? "" : stderr_output);
-        }
+        int code = run_command_with_stdin(dot_source, argv, ignored, stderr_output, limits_of(options));
+        check_exit(code, argv, "<ignored>", stderr_output, options);
     }
 
     // 渲染字符串为内存图像（无需任何临时文件）
     static std::vector<uint8_t> render_from_string_to_memory(const std::string& dot_source,
                                                              const RenderOptions& options = RenderOptions()) {
-        validate_options(options, /*input_file*/ "", /*output_file*/ "");
+        std::string exe = validate_options(options, /*input_file*/ "", /*output_file*/ "");
 
-        std::ostringstream cmd = build_command(
+        std::vector<std::string> argv = build_argv(
+            exe,
             /*input_file*/ "",
             /*output_file*/ "",
             options,
@@ -91,21 +97,289 @@ class Renderer {
 
         std::vector<uint8_t> out;
         std::string stderr_output;
-        int code = run_command_with_stdin(dot_source, cmd.str(), out, stderr_output);
-        if (code != 0) {
-            throw CalledProcessError(code, cmd.str(), "<ignored>", options.quiet ? "" : stderr_output);
+        int code = run_command_with_stdin(dot_source, argv, out, stderr_output, limits_of(options));
+        check_exit(code, argv, "<ignored>", stderr_output, options);
+
+        return out;
+    }
+
+    // 渲染生产者输出的 DOT 为文件, 序列化与 dot 读取同时进行, 不构造完整字符串
+    static void render_from_producer(const DotProducer& produce,
+                                     const std::string& output_file,
+                                     RenderOptions options = RenderOptions()) {
+        std::string exe = validate_options(options, /*input_file*/ "", output_file);
+
+        if (output_file.empty()) {
+            throw RequiredArgumentError("output_file (required)");
         }
 
+        deduce_format(output_file, options);
+
+        std::vector<std::string> argv = build_argv(
+            exe,
+            /*input_file*/ "",
+            output_file,
+            options,
+            /*to_stdout=*/false,
+            /*use_stdin=*/true);
+
+        std::vector<uint8_t> ignored;
+        std::string stderr_output;
+        int code = run_command_with_producer(produce, argv, ignored, stderr_output, limits_of(options));
+        check_exit(code, argv, "<ignored>", stderr_output, options);
+    }
+
+    static std::vector<uint8_t> render_from_producer_to_memory(const DotProducer& produce,
+                                                               const RenderOptions& options = RenderOptions()) {
+        std::string exe = validate_options(options, /*input_file*/ "", /*output_file*/ "");
+
+        std::vector<std::string> argv = build_argv(
+            exe,
+            /*input_file*/ "",
+            /*output_file*/ "",
+            options,
+            /*to_stdout=*/true,
+            /*use_stdin=*/true);
+
+        std::vector<uint8_t> out;
+        std::string stderr_output;
+        int code = run_command_with_producer(produce, argv, out, stderr_output, limits_of(options));
+        check_exit(code, argv, "<ignored>", stderr_output, options);
+
         return out;
     }
 
-  private:
+    // 输出按块交给 sink, 边产生边转发, 不在内存中攒出完整结果. engine 失败时 sink 可能已经收到部分输出
+    template <typename Sink>
+    static void render_from_producer_to_sink(const DotProducer& produce,
+                                             ByteSink<Sink>& sink,
+                                             const RenderOptions& options = RenderOptions()) {
+        std::vector<std::string> argv = stdout_argv(options);
+        std::string stderr_output;
+        int code = run_command_with_producer_to_sink(produce, argv, sink, stderr_output, limits_of(options));
+        check_exit(code, argv, "<streamed>", stderr_output, options);
+    }
+
+    template <typename Sink>
+    static void render_from_string_to_sink(const std::string& dot_source,
+                                           ByteSink<Sink>& sink,
+                                           const RenderOptions& options = RenderOptions()) {
+        std::vector<std::string> argv = stdout_argv(options);
+        std::string stderr_output;
+        int code = run_command_with_stdin_to_sink(dot_source, argv, sink, stderr_output, limits_of(options));
+        check_exit(code, argv, "<streamed>", stderr_output, options);
+    }
+
+    // fd 直接作为 engine 的 stdout, 输出不经过本进程. fd 应为阻塞模式; 调用方负责关闭
     static void
+    render_from_producer_to_fd(const DotProducer& produce, int fd, const RenderOptions& options = RenderOptions()) {
+        std::vector<std::string> argv = stdout_argv(options);
+        std::string stderr_output;
+        int code = run_command_with_producer_to_fd(produce, argv, fd, stderr_output, limits_of(options));
+        check_exit(code, argv, "<streamed>", stderr_output, options);
+    }
+
+    static void
+    render_from_string_to_fd(const std::string& dot_source, int fd, const RenderOptions& options = RenderOptions()) {
+        std::vector<std::string> argv = stdout_argv(options);
+        std::string stderr_output;
+        int code = run_command_with_stdin_to_fd(dot_source, argv, fd, stderr_output, limits_of(options));
+        check_exit(code, argv, "<streamed>", stderr_output, options);
+    }
+
+    // options.outputs 中的全部结果由一个 engine 进程、一次 layout 产出 (-Tfmt1 -ofile1 -Tfmt2 -ofile2 ...).
+    // 没有 path 的输出先写到临时文件, 结束后读回并删除
+    static RenderResults render_outputs_from_producer(const DotProducer& produce, const RenderOptions& options) {
+        OutputPlan plan(options);
+        std::vector<std::string> argv = plan.build_argv(validate_options(options, "", ""), options);
+
+        std::vector<uint8_t> ignored;
+        std::string stderr_output;
+        int code = run_command_with_producer(produce, argv, ignored, stderr_output, limits_of(options));
+        check_exit(code, argv, "<ignored>", stderr_output, options);
+        return plan.collect();
+    }
+
+    static RenderResults render_outputs_from_string(const std::string& dot_source, const RenderOptions& options) {
+        OutputPlan plan(options);
+        std::vector<std::string> argv = plan.build_argv(validate_options(options, "", ""), options);
+
+        std::vector<uint8_t> ignored;
+        std::string stderr_output;
+        int code = run_command_with_stdin(dot_source, argv, ignored, stderr_output, limits_of(options));
+        check_exit(code, argv, "<ignored>", stderr_output, options);
+        return plan.collect();
+    }
+
+    // 把多个已布局的图 (-Tdot 输出) 交给 gvpack 合并为一张图, 返回带坐标的 DOT, 之后用 neato -n2 渲染.
+    // gvpack 取自 options.engine 的同一目录; margin < 0 时使用 gvpack 的默认值
+    static std::string pack_layouts(const std::vector<std::string>& layouts, const RenderOptions& options, int margin) {
+        std::string exe = resolve_executable(Layout::sibling_tool(options.engine, "gvpack"));
+        if (exe.empty()) throw ExecutableNotFound(Layout::sibling_tool(options.engine, "gvpack"));
+
+        std::vector<std::string> argv;
+        argv.push_back(exe);
+        if (margin >= 0) argv.push_back("-m" + std::to_string(margin));
+
+        std::vector<uint8_t> out;
+        std::string stderr_output;
+        int code = run_command_with_producer(
+            [&layouts](DotWriter& w) {
+                for (const auto& text : layouts) w.write(text);
+            },
+            argv,
+            out,
+            stderr_output,
+            limits_of(options));
+        check_exit(code, argv, "<ignored>", stderr_output, options);
+        return std::string(out.begin(), out.end());
+    }
+
+    // 输出的完整格式串; 没有指定时从 path 推断
+    static std::string output_format(const RenderOutput& output) {
+        std::string fmt = output.format.empty() ? get_format_from_filename(output.path) : output.format;
+        if (fmt.empty()) {
+            throw RequiredArgumentError("format must be set either via the output or its filename");
+        }
+        return fmt;
+    }
+
+    static std::string get_format_from_filename(const std::string& filename) {
+        auto pos = filename.rfind('.');
+        if (pos != std::string::npos && pos + 1 < filename.size()) {
+            return filename.substr(pos + 1); // e.g. "svg"
+        }
+        return "";
+    }
+
+    static std::string deduce_format(const std::string& filename, RenderOptions& options) {
+        std::string fmt = options.format;
+        if (fmt.empty()) {
+            // 隐式推断类型
+            fmt = get_format_from_filename(filename);
+            if (fmt.empty()) {
+                throw RequiredArgumentError("format must be set either via options or output filename");
+            } else {
+                options.set_format(fmt);
+            }
+        }
+        return fmt;
+    }
+
+    // 单个输出对应的普通渲染选项: 拆开 "fmt:renderer:formatter", 清空 outputs
+    static RenderOptions options_for_output(const RenderOptions& options, const RenderOutput& output) {
+        RenderOptions opts = options;
+        opts.outputs.clear();
+        std::string fmt = output_format(output);
+        auto p1 = fmt.find(':');
+        opts.format = fmt.substr(0, p1);
+        opts.renderer.clear();
+        opts.formatter.clear();
+        if (p1 != std::string::npos) {
+            auto p2 = fmt.find(':', p1 + 1);
+            opts.renderer = fmt.substr(p1 + 1, p2 == std::string::npos ? std::string::npos : p2 - p1 - 1);
+            if (p2 != std::string::npos) opts.formatter = fmt.substr(p2 + 1);
+        }
+        return opts;
+    }
+
+  private:
+    // 从 stdin 读 DOT、结果写到 stdout 的 argv
+    static std::vector<std::string> stdout_argv(const RenderOptions& options) {
+        std::string exe = validate_options(options, /*input_file*/ "", /*output_file*/ "");
+        return build_argv(exe, "", "", options, /*to_stdout=*/true, /*use_stdin=*/true);
+    }
+
+    // render_outputs 的输出列表与内存结果用的临时文件; 析构时删除临时文件
+    class OutputPlan {
+      public:
+        explicit OutputPlan(const RenderOptions& options) {
+            if (options.outputs.empty()) {
+                throw RequiredArgumentError("outputs (required by render_outputs)");
+            }
+            for (const auto& output : options.outputs) {
+                std::string fmt = output_format(output);
+                if (output.path.empty()) {
+                    // 同一格式只渲染一份
+                    if (results_.count(fmt)) continue;
+                    std::string ext = fmt.substr(0, fmt.find(':'));
+                    temps_.push_back(std::make_pair(fmt, TmpFile::generate_path(ext)));
+                    results_[fmt];
+                    targets_.push_back(std::make_pair(fmt, temps_.back().second));
+                } else {
+                    if (options.raise_if_result_exists) {
+                        std::ifstream check(output.path.c_str());
+                        if (check.good()) throw FileExistsError(output.path);
+                    }
+                    targets_.push_back(std::make_pair(fmt, output.path));
+                }
+            }
+        }
+
+        ~OutputPlan() {
+            for (const auto& t : temps_) std::remove(t.second.c_str());
+        }
+
+        OutputPlan(const OutputPlan&) = delete;
+        OutputPlan& operator=(const OutputPlan&) = delete;
+
+        // dot 按顺序把每个 -o 绑定到它前面最近的 -T
+        std::vector<std::string> build_argv(const std::string& exe, const RenderOptions& options) const {
+            std::vector<std::string> argv;
+            argv.push_back(exe);
+            if (options.neato_no_op) {
+                argv.push_back(options.neato_no_op_arg());
+            }
+            for (const auto& t : targets_) {
+                argv.push_back("-T" + t.first);
+                argv.push_back("-o" + t.second);
+            }
+            return argv;
+        }
+
+        RenderResults collect() {
+            for (const auto& t : temps_) {
+                std::ifstream in(t.second.c_str(), std::ios::binary);
+                if (! in) throw std::runtime_error("Failed to read render output: " + t.second);
+                std::vector<uint8_t>& data = results_[t.first];
+                data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+            return std::move(results_);
+        }
+
+      private:
+        std::vector<std::pair<std::string, std::string>> targets_; // (format, path), 按命令行顺序
+        std::vector<std::pair<std::string, std::string>> temps_;   // 内存结果的 (format, 临时文件)
+        RenderResults results_;
+    };
+
+    static RunLimits limits_of(const RenderOptions& options) {
+        RunLimits limits;
+        limits.timeout_ms = options.timeout_ms;
+        limits.cancel = options.cancel_token.get();
+        return limits;
+    }
+
+    static void check_exit(int code,
+                           const std::vector<std::string>& argv,
+                           const std::string& stdout_output,
+                           const std::string& stderr_output,
+                           const RenderOptions& options) {
+        if (code == 0) return;
+        std::string cmd = format_command(argv);
+        if (code == RunTimedOut) throw TimeoutExpired(cmd, options.timeout_ms);
+        if (code == RunCancelled) throw RenderCancelled(cmd);
+        throw CalledProcessError(code, cmd, stdout_output, options.quiet ? "" : stderr_output);
+    }
+
+    // 校验参数并返回 engine 的可执行文件路径
+    static std::string
     validate_options(const RenderOptions& options, const std::string& input_file, const std::string& output_file) {
         if (! options.formatter.empty() && options.renderer.empty()) {
             throw RequiredArgumentError("renderer (required by formatter)");
         }
-        if (! is_executable_available(options.engine)) {
+        std::string exe = resolve_executable(options.engine);
+        if (exe.empty()) {
             throw ExecutableNotFound(options.engine);
         }
         if (input_file == output_file && input_file != "" && ! options.overwrite_filepath) {
@@ -117,77 +391,58 @@ class Renderer {
                 throw FileExistsError(output_file);
             }
         }
+        return exe;
     }
 
-    static std::ostringstream build_command(const std::string& input_file,
-                                            const std::string& output_file,
-                                            const RenderOptions& options,
-                                            bool to_stdout,
-                                            bool use_stdin = false) {
-        std::ostringstream cmd;
-        cmd << options.engine;
+    // 直接作为 engine 的 argv, 参数不经过 shell, 路径中的空格和引号无需转义
+    static std::vector<std::string> build_argv(const std::string& exe,
+                                               const std::string& input_file,
+                                               const std::string& output_file,
+                                               const RenderOptions& options,
+                                               bool to_stdout,
+                                               bool use_stdin = false) {
+        std::vector<std::string> argv;
+        argv.push_back(exe);
 
         if (options.format.empty()) {
             throw RequiredArgumentError("format");
         }
 
-        cmd << " -T" << options.format;
-
+        std::string fmt = "-T" + options.format;
         if (! options.renderer.empty()) {
-            cmd << ":" << options.renderer;
+            fmt += ":" + options.renderer;
             if (! options.formatter.empty()) {
-                cmd << ":" << options.formatter;
+                fmt += ":" + options.formatter;
             }
         }
+        argv.push_back(fmt);
 
         if (options.neato_no_op) {
-            cmd << " -n";
+            argv.push_back(options.neato_no_op_arg());
         }
 
         // 输入文件
         if (! use_stdin) {
-            cmd << " \"" << input_file << "\"";
+            argv.push_back(input_file);
         }
 
         // 输出到文件或 stdout
         if (to_stdout) {
             // 什么都不做, 默认输出到 stdout
         } else if (! output_file.empty()) {
-            cmd << " -o \"" << output_file << "\"";
+            argv.push_back("-o" + output_file);
         }
 
-        return cmd;
+        return argv;
     }
 
-    static bool is_executable_available(const std::string& exe) {
+    static std::string resolve_executable(const std::string& exe) {
 #if defined(_WIN32)
         std::string test_cmd = "where " + exe + " >nul 2>&1";
+        return std::system(test_cmd.c_str()) == 0 ? exe : "";
 #else
-        std::string test_cmd = "command -v " + exe + " >/dev/null 2>&1";
+        return ExecutableResolver::resolve(exe);
 #endif
-        return std::system(test_cmd.c_str()) == 0;
-    }
-
-    static std::string get_format_from_filename(const std::string& filename) {
-        auto pos = filename.rfind('.');
-        if (pos != std::string::npos && pos + 1 < filename.size()) {
-            return filename.substr(pos + 1); // e.g. "svg"
-        }
-        return "";
-    }
-
-    static std::string deduce_format(const std::string& filename, RenderOptions& options) {
-        std::string fmt = options.format;
-        if (fmt.empty()) {
-            // 隐式推断类型
-            fmt = get_format_from_filename(filename);
-            if (fmt.empty()) {
-                throw RequiredArgumentError("format must be set either via options or output filename");
-            } else {
-                options.set_format(fmt);
-            }
-        }
-        return fmt;
     }
 };
 
@@ -0,0 +1,270 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+
+#include "dot_writer.hpp"
+#include "render.hpp"
+#include "sha256.hpp"
+#include "../exceptions.hpp"
+#include "../options.hpp"
+
+namespace kgraphviz {
+
+struct RenderCacheStats {
+    uint64_t hits = 0;       // 内存或磁盘命中
+    uint64_t disk_hits = 0;  // 其中来自磁盘的命中
+    uint64_t misses = 0;
+    uint64_t evictions = 0;  // 因超出内存上限被淘汰的条目
+    uint64_t bytes = 0;      // 当前内存占用
+    uint64_t entries = 0;    // 当前内存条目数
+};
+
+// 以 DOT 文本 + 影响输出的 RenderOptions 字段的 SHA-256 为内容地址的渲染结果缓存.
+// 内存层按字节数做 LRU 淘汰, 可选的磁盘层把结果写到 disk_dir/<key>.bin.
+// 线程安全, 可以在多个 RenderOptions 之间共享同一个实例.
+class RenderCache {
+  public:
+    explicit RenderCache(size_t max_bytes = 64 * 1024 * 1024, const std::string& disk_dir = "")
+        : max_bytes_(max_bytes), disk_dir_(disk_dir) {}
+
+    RenderCache(const RenderCache&) = delete;
+    RenderCache& operator=(const RenderCache&) = delete;
+
+    // 流式计算 key, DOT 文本不需要整体驻留内存
+    static std::string make_key(const DotProducer& produce, const RenderOptions& options) {
+        Hasher h;
+        {
+            DotWriter writer([&h](const char* data, size_t len) { h.update(data, len); });
+            produce(writer);
+        }
+        return h.finish(options);
+    }
+
+    static std::string make_key(const std::string& dot_source, const RenderOptions& options) {
+        Hasher h;
+        h.update(dot_source.data(), dot_source.size());
+        return h.finish(options);
+    }
+
+    bool lookup(const std::string& key, std::vector<uint8_t>& out) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(key);
+            if (it != index_.end()) {
+                lru_.splice(lru_.begin(), lru_, it->second);
+                out = it->second->data;
+                ++stats_.hits;
+                return true;
+            }
+        }
+
+        if (! disk_dir_.empty() && read_disk(key, out)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.hits;
+            ++stats_.disk_hits;
+            insert_locked(key, out);
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.misses;
+        return false;
+    }
+
+    void store(const std::string& key, const std::vector<uint8_t>& data) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            insert_locked(key, data);
+        }
+        if (! disk_dir_.empty()) write_disk(key, data);
+    }
+
+    // 先查缓存, 未命中时调用 render() 并写回
+    template <typename RenderFn>
+    std::vector<uint8_t> get_or_render(const std::string& key, RenderFn render) {
+        std::vector<uint8_t> out;
+        if (lookup(key, out)) return out;
+        out = render();
+        store(key, out);
+        return out;
+    }
+
+    RenderCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    // 只清空内存层, 磁盘层文件保留
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lru_.clear();
+        index_.clear();
+        stats_.bytes = 0;
+        stats_.entries = 0;
+    }
+
+    size_t max_bytes() const {
+        return max_bytes_;
+    }
+
+    const std::string& disk_dir() const {
+        return disk_dir_;
+    }
+
+  private:
+    struct Entry {
+        std::string key;
+        std::vector<uint8_t> data;
+    };
+
+    // DOT 文本与各输出字段的 SHA-256, 64 个十六进制字符
+    struct Hasher {
+        Sha256 sha;
+        uint64_t length = 0;
+
+        void update(const char* data, size_t len) {
+            sha.update(data, len);
+            length += len;
+        }
+
+        void field(const std::string& s) {
+            update(s.data(), s.size());
+            update("\0", 1); // 分隔符, 避免字段拼接产生歧义
+        }
+
+        std::string finish(const RenderOptions& options) {
+            // 文本之后先记下它的长度, 文本中含 '\0' 也不会与后面的字段混淆
+            field(std::to_string(length));
+            field(options.engine);
+            field(options.format);
+            field(options.renderer);
+            field(options.formatter);
+            field(options.neato_no_op ? options.neato_no_op_arg().substr(1) : "");
+            return sha.hex_digest();
+        }
+    };
+
+    size_t max_bytes_;
+    std::string disk_dir_;
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_; // 头部为最近使用
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    RenderCacheStats stats_;
+
+    void insert_locked(const std::string& key, const std::vector<uint8_t>& data) {
+        if (data.size() > max_bytes_) return; // 单个结果超过上限, 只放磁盘层
+
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            stats_.bytes -= it->second->data.size();
+            it->second->data = data;
+            stats_.bytes += data.size();
+            lru_.splice(lru_.begin(), lru_, it->second);
+        } else {
+            lru_.push_front(Entry{key, data});
+            index_[key] = lru_.begin();
+            stats_.bytes += data.size();
+            ++stats_.entries;
+        }
+
+        while (stats_.bytes > max_bytes_ && ! lru_.empty()) {
+            const Entry& victim = lru_.back();
+            stats_.bytes -= victim.data.size();
+            index_.erase(victim.key);
+            lru_.pop_back();
+            --stats_.entries;
+            ++stats_.evictions;
+        }
+    }
+
+    std::string disk_path(const std::string& key) const {
+        return disk_dir_ + "/" + key + ".bin";
+    }
+
+    bool read_disk(const std::string& key, std::vector<uint8_t>& out) const {
+        std::ifstream in(disk_path(key).c_str(), std::ios::binary);
+        if (! in) return false;
+        in.seekg(0, std::ios::end);
+        std::streamoff size = in.tellg();
+        if (size < 0) return false;
+        in.seekg(0, std::ios::beg);
+        out.resize(static_cast<size_t>(size));
+        if (size > 0 && ! in.read(reinterpret_cast<char*>(out.data()), size)) {
+            out.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // 先写临时文件再 rename, 并发写同一个 key 也不会读到半个文件. 磁盘层写失败不影响渲染结果
+    void write_disk(const std::string& key, const std::vector<uint8_t>& data) const {
+        std::string final_path = disk_path(key);
+        static std::atomic<unsigned long> seq(0);
+        std::string tmp_path =
+            final_path + ".tmp." + std::to_string(static_cast<long>(getpid())) + "." + std::to_string(seq++);
+        {
+            std::ofstream out(tmp_path.c_str(), std::ios::binary);
+            if (! out) return;
+            out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+            if (! out) {
+                out.close();
+                std::remove(tmp_path.c_str());
+                return;
+            }
+        }
+        if (std::rename(tmp_path.c_str(), final_path.c_str()) != 0) {
+            std::remove(tmp_path.c_str());
+        }
+    }
+};
+
+// 把内存中的渲染结果 (缓存命中 / worker 输出) 写到 output_file, 行为与 Renderer 的文件输出一致
+inline void write_cached_output(const std::string& output_file,
+                                const std::vector<uint8_t>& data,
+                                const RenderOptions& options) {
+    if (output_file.empty()) {
+        throw RequiredArgumentError("output_file (required)");
+    }
+    if (options.raise_if_result_exists) {
+        std::ifstream check(output_file.c_str());
+        if (check.good()) {
+            throw FileExistsError(output_file);
+        }
+    }
+    std::ofstream out(output_file.c_str(), std::ios::binary);
+    if (! out) throw std::runtime_error("Failed to open file for writing: " + output_file);
+    out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (! out) throw std::runtime_error("Failed to write file: " + output_file);
+}
+
+// 不能一次产出多个结果的后端 (worker / 缓存) 的 render_outputs: 逐个输出调用 render, 每个输出各做一次 layout
+inline RenderResults render_outputs_each(const RenderOptions& options,
+                                         const std::function<std::vector<uint8_t>(const RenderOptions&)>& render) {
+    if (options.outputs.empty()) {
+        throw RequiredArgumentError("outputs (required by render_outputs)");
+    }
+    RenderResults results;
+    for (const auto& output : options.outputs) {
+        RenderOptions opts = Renderer::options_for_output(options, output);
+        if (output.path.empty()) {
+            std::string fmt = Renderer::output_format(output);
+            if (! results.count(fmt)) results[fmt] = render(opts);
+        } else {
+            write_cached_output(output.path, render(opts), opts);
+        }
+    }
+    return results;
+}
+
+} // namespace kgraphviz
@@ -1,19 +1,43 @@
 #pragma once
 
+#include <chrono>
+#include <algorithm>
 #include <cstdint>
+#include <functional>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
-#include <vector>
-#include <string>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <cerrno>
 #include <cstring>
 
+#include "cancel_token.hpp"
+#include "dot_writer.hpp"
+
+extern char** environ;
+
 namespace kgraphviz {
-namespace {
+
+// run_command* 在子进程被主动终止时的返回码
+const static int RunTimedOut = -6;
+const static int RunCancelled = -7;
+
+// 单次命令执行的限制: 超时 (毫秒, 0 表示不限) 与可选的取消令牌
+struct RunLimits {
+    long timeout_ms = 0;
+    const CancelToken* cancel = nullptr;
+};
+// 接收子进程输出的 sink (CRTP): 派生类实现 append_impl / clear_impl.
+// 输出按读到的块依次 append, 用户自定义的 sink 可以边收边转发, 不必攒出完整结果
 template <typename Derived>
 struct ByteSink {
     void append(const uint8_t* data, size_t len) {
@@ -53,107 +77,568 @@ struct StringSink : ByteSink<StringSink> {
     }
 };
 
+// 每块输出交给回调. 已经交出去的数据无法撤回, clear 为空操作
+struct CallbackSink : ByteSink<CallbackSink> {
+    std::function<void(const uint8_t*, size_t)> callback;
+
+    explicit CallbackSink(std::function<void(const uint8_t*, size_t)> cb) : callback(std::move(cb)) {}
+
+    void append_impl(const uint8_t* data, size_t len) {
+        callback(data, len);
+    }
+
+    void clear_impl() {}
+};
+
+// 阻塞地写入 fd, 写失败时抛出 std::runtime_error
+struct FdSink : ByteSink<FdSink> {
+    int fd;
+
+    explicit FdSink(int fd_) : fd(fd_) {}
+
+    void append_impl(const uint8_t* data, size_t len) {
+        while (len > 0) {
+            ssize_t n = ::write(fd, data, len);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("Failed to write render output to fd: ") + std::strerror(errno));
+            }
+            data += n;
+            len -= static_cast<size_t>(n);
+        }
+    }
+
+    void clear_impl() {}
+};
+
+namespace {
+const static size_t PipeBufferSize = 64 * 1024;
+
+// stdin 与 stdout/stderr 通过 poll 交错处理, 避免子进程输出填满管道后双方互相阻塞.
+// 写 stdin 期间同时把子进程已经产生的输出读走, 所以 DOT 文本可以边生成边喂给 dot.
 template <typename StdoutSink, typename StderrSink>
-inline int run_command_sink(const std::string& cmd,
-                            StdoutSink& stdout_sink,
-                            StderrSink& stderr_sink,
-                            const std::string* stdin_data = nullptr) {
-    int stdin_pipe[2], stdout_pipe[2], stderr_pipe[2];
-    if (pipe(stdout_pipe) != 0 || pipe(stderr_pipe) != 0 || pipe(stdin_pipe) != 0) {
-        return -1;
+class PipeSession {
+  public:
+    PipeSession(StdoutSink& stdout_sink, StderrSink& stderr_sink)
+        : stdout_sink_(stdout_sink), stderr_sink_(stderr_sink), buf_(PipeBufferSize) {}
+
+    ~PipeSession() {
+        close_fd(stdin_fd_);
+        close_fd(stdout_fd_);
+        close_fd(stderr_fd_);
+        if (pid_ > 0) {
+            // 异常路径: 子进程还没被回收, 直接杀掉避免僵尸
+            ::kill(pid_, SIGKILL);
+            reap();
+        }
     }
 
-    pid_t pid = fork();
-    if (pid < 0) { // fork 失败, 清理返回
-        close(stdout_pipe[0]);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[0]);
-        close(stderr_pipe[1]);
-        close(stdin_pipe[0]);
-        close(stdin_pipe[1]);
-        return -2;
+    PipeSession(const PipeSession&) = delete;
+    PipeSession& operator=(const PipeSession&) = delete;
+
+    // 在 start() 之前调用: 子进程的 stdout 直接 dup 成 fd, 输出不经过本进程, stdout sink 不会收到数据
+    void redirect_stdout(int fd) {
+        stdout_target_ = fd;
     }
 
-    if (pid == 0) {
-        // 子进程：重定向 stdin/stdout/stderr
-        dup2(stdin_pipe[0], STDIN_FILENO);
-        dup2(stdout_pipe[1], STDOUT_FILENO);
-        dup2(stderr_pipe[1], STDERR_FILENO);
+    // 返回 0 表示成功, 负数为与 run_command_sink 一致的错误码
+    int start(const std::vector<std::string>& argv, const RunLimits& limits = RunLimits()) {
+        cancel_ = limits.cancel;
+        has_deadline_ = limits.timeout_ms > 0;
+        if (has_deadline_) {
+            deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.timeout_ms);
+        }
+        if (cancel_ && cancel_->cancelled()) return RunCancelled;
+
+        bool own_stdout = stdout_target_ < 0;
+        int stdin_pipe[2], stdout_pipe[2] = {-1, -1}, stderr_pipe[2];
+        if (own_stdout && make_pipe(stdout_pipe) != 0) return -1;
+        if (make_pipe(stderr_pipe) != 0) {
+            close_pair(stdout_pipe);
+            return -1;
+        }
+        if (make_pipe(stdin_pipe) != 0) {
+            close_pair(stdout_pipe);
+            close_pair(stderr_pipe);
+            return -1;
+        }
+
+        // posix_spawn 在 glibc 上走 vfork/CLONE_VFORK 路径, 不复制父进程页表, 也不再经过 /bin/sh
+        std::vector<char*> args;
+        args.reserve(argv.size() + 1);
+        for (const auto& a : argv) args.push_back(const_cast<char*>(a.c_str()));
+        args.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        // 子进程：重定向 stdin/stdout/stderr; 管道原始 fd 都带 close-on-exec, exec 时自动关闭
+        posix_spawn_file_actions_adddup2(&actions, stdin_pipe[0], STDIN_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, own_stdout ? stdout_pipe[1] : stdout_target_, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, stderr_pipe[1], STDERR_FILENO);
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+        // 调用方自己打开但没设 close-on-exec 的 fd 也不应泄漏给 engine
+        posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+#endif
+
+        // 当前线程屏蔽了 SIGPIPE (见 SigpipeGuard), 子进程应恢复默认的信号屏蔽字与处理方式
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        sigset_t empty_mask, default_signals;
+        sigemptyset(&empty_mask);
+        sigemptyset(&default_signals);
+        sigaddset(&default_signals, SIGPIPE);
+        posix_spawnattr_setsigmask(&attr, &empty_mask);
+        posix_spawnattr_setsigdefault(&attr, &default_signals);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+        pid_t pid = -1;
+        int spawn_rc = EINVAL;
+        if (! argv.empty()) {
+            // 含 '/' 的路径直接执行, 否则按 PATH 查找
+            if (argv[0].find('/') != std::string::npos) {
+                spawn_rc = posix_spawn(&pid, argv[0].c_str(), &actions, &attr, args.data(), environ);
+            } else {
+                spawn_rc = posix_spawnp(&pid, argv[0].c_str(), &actions, &attr, args.data(), environ);
+            }
+        }
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+
+        if (spawn_rc != 0) { // spawn 失败, 清理返回
+            close_pair(stdout_pipe);
+            close_pair(stderr_pipe);
+            close_pair(stdin_pipe);
+            return -2;
+        }
 
+        // 父进程
+        pid_ = pid;
         close(stdin_pipe[0]);
-        close(stdin_pipe[1]);
-        close(stdout_pipe[0]);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[0]);
         close(stderr_pipe[1]);
+        stdin_fd_ = stdin_pipe[1];
+        stderr_fd_ = stderr_pipe[0];
+        prepare_fd(stdin_fd_);
+        prepare_fd(stderr_fd_);
+        if (own_stdout) {
+            close(stdout_pipe[1]);
+            stdout_fd_ = stdout_pipe[0];
+            prepare_fd(stdout_fd_);
+            grow_pipe(stdout_fd_);
+        }
 
-        execl("/bin/sh", "sh", "-c", cmd.c_str(), (char*)nullptr);
-        _exit(127);
+        stdout_sink_.clear();
+        stderr_sink_.clear();
+        return 0;
     }
 
-    // 父进程
-    close(stdin_pipe[0]);
-    close(stdout_pipe[1]);
-    close(stderr_pipe[1]);
+    // 写入 stdin, 直到全部写完或子进程关闭了读端 (EPIPE). 返回 false 表示发生了不可恢复的写错误
+    bool write_stdin(const char* data, size_t len) {
+        while (len > 0 && stdin_fd_ >= 0) {
+            if (! poll_once(/*want_write=*/true)) return false;
+            if (! (revents_[0] & (POLLOUT | POLLERR | POLLHUP))) continue;
 
-    // 写入 stdin 数据（如 DOT 字符串）
-    if (stdin_data && ! stdin_data->empty()) {
-        ssize_t n = write(stdin_pipe[1], stdin_data->data(), stdin_data->size());
-        if (n < 0) {
-            close(stdin_pipe[1]);
-            close(stdout_pipe[0]);
-            close(stderr_pipe[0]);
-            return -5;
+            ssize_t n = ::write(stdin_fd_, data, len);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+                if (errno == EPIPE) {
+                    // 子进程提前退出 (例如语法错误), 剩余输入丢弃, 结果以退出码为准
+                    close_fd(stdin_fd_);
+                    return true;
+                }
+                write_failed_ = true;
+                return false;
+            }
+            data += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // 关闭 stdin, 读完剩余输出并等待子进程退出, 返回退出码或负数错误码
+    int finish() {
+        close_fd(stdin_fd_); // 重要：关闭 write 端，防止子进程 hang 住等待 EOF
+        while (stdout_fd_ >= 0 || stderr_fd_ >= 0) {
+            if (! poll_once(/*want_write=*/false)) break;
+        }
+        close_fd(stdout_fd_);
+        close_fd(stderr_fd_);
+
+        int status = reap();
+        if (abort_code_ != 0) return abort_code_;
+        if (status == -3) return -3;
+        if (write_failed_) return -5;
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -4;
+    }
+
+  private:
+    StdoutSink& stdout_sink_;
+    StderrSink& stderr_sink_;
+    std::vector<char> buf_;
+
+    pid_t pid_ = -1;
+    int stdin_fd_ = -1;
+    int stdout_fd_ = -1;
+    int stderr_fd_ = -1;
+    int stdout_target_ = -1; // redirect_stdout() 指定的 fd
+    bool write_failed_ = false;
+    short revents_[3] = {0, 0, 0};
+
+    const CancelToken* cancel_ = nullptr;
+    bool has_deadline_ = false;
+    std::chrono::steady_clock::time_point deadline_;
+    int abort_code_ = 0;
+
+    static void close_fd(int& fd) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    // 管道创建时即带 close-on-exec, 否则其他线程并发 fork 出的子进程会继承写端,
+    // 导致本次的子进程永远等不到 stdin EOF. dup2 到 0/1/2 后的副本不带该标志
+    static int make_pipe(int p[2]) {
+#if defined(__linux__)
+        return pipe2(p, O_CLOEXEC);
+#else
+        if (pipe(p) != 0) return -1;
+        fcntl(p[0], F_SETFD, FD_CLOEXEC);
+        fcntl(p[1], F_SETFD, FD_CLOEXEC);
+        return 0;
+#endif
+    }
+
+    static void close_pair(int p[2]) {
+        if (p[0] >= 0) close(p[0]);
+        if (p[1] >= 0) close(p[1]);
+    }
+
+    static void prepare_fd(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    // 只放大 stdout 管道 (Linux): 输出通常是最大的一路, 256 KiB 已能明显减少大图的上下文切换;
+    // 管道缓冲区计入每用户的配额 (pipe-user-pages-soft), 并发渲染多时不宜每个管道都取大值. 失败无所谓
+    static void grow_pipe(int fd) {
+#ifdef F_SETPIPE_SZ
+        fcntl(fd, F_SETPIPE_SZ, 256 * 1024);
+#else
+        (void)fd;
+#endif
+    }
+
+    int reap() {
+        int status = 0;
+        while (waitpid(pid_, &status, 0) < 0) {
+            if (errno != EINTR) {
+                pid_ = -1;
+                return -3;
+            }
+        }
+        pid_ = -1;
+        return status;
+    }
+
+    // 超时或取消: 杀掉子进程并关闭所有管道, 之后 finish() 只负责回收
+    void abort(int code) {
+        abort_code_ = code;
+        if (pid_ > 0) ::kill(pid_, SIGKILL);
+        close_fd(stdin_fd_);
+        close_fd(stdout_fd_);
+        close_fd(stderr_fd_);
+    }
+
+    // 距离 deadline 的剩余毫秒数, 用作 poll 超时; -1 表示无限等待
+    int poll_timeout() const {
+        int timeout = -1;
+        if (has_deadline_) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline_ -
+                                                                              std::chrono::steady_clock::now())
+                            .count();
+            timeout = left > 0 ? static_cast<int>(std::min<long long>(left, 1 << 30)) : 0;
+        }
+        if (cancel_ && cancel_->fd() < 0) {
+            // 没有自管道可等, 退化为定期检查取消标志
+            timeout = (timeout < 0 || timeout > 50) ? 50 : timeout;
         }
+        return timeout;
     }
-    close(stdin_pipe[1]); // 重要：关闭 write 端，防止子进程 hang 住等待 EOF
 
-    stdout_sink.clear();
-    stderr_sink.clear();
+    // 等待任一 fd 就绪并处理可读端. 返回 false 表示 poll 本身失败或执行已被终止
+    bool poll_once(bool want_write) {
+        if (abort_code_ != 0) return false;
 
-    char buf[4096];
-    ssize_t n;
+        struct pollfd fds[4];
+        fds[0].fd = want_write ? stdin_fd_ : -1;
+        fds[0].events = POLLOUT;
+        fds[1].fd = stdout_fd_;
+        fds[1].events = POLLIN;
+        fds[2].fd = stderr_fd_;
+        fds[2].events = POLLIN;
+        fds[3].fd = cancel_ ? cancel_->fd() : -1;
+        fds[3].events = POLLIN;
+        for (auto& f : fds) f.revents = 0;
+
+        int rc = ::poll(fds, 4, poll_timeout());
+        if (rc < 0) {
+            if (errno == EINTR) {
+                revents_[0] = revents_[1] = revents_[2] = 0;
+                return true;
+            }
+            write_failed_ = write_failed_ || want_write;
+            return false;
+        }
+
+        if (cancel_ && cancel_->cancelled()) {
+            abort(RunCancelled);
+            return false;
+        }
+        if (has_deadline_ && std::chrono::steady_clock::now() >= deadline_) {
+            abort(RunTimedOut);
+            return false;
+        }
+
+        revents_[0] = fds[0].revents;
+        revents_[1] = fds[1].revents;
+        revents_[2] = fds[2].revents;
+
+        if (revents_[1]) drain(stdout_fd_, stdout_sink_);
+        if (revents_[2]) drain(stderr_fd_, stderr_sink_);
+        return true;
+    }
+
+    template <typename Sink>
+    void drain(int& fd, Sink& sink) {
+        for (;;) {
+            ssize_t n = ::read(fd, buf_.data(), buf_.size());
+            if (n > 0) {
+                sink.append(reinterpret_cast<const uint8_t*>(buf_.data()), static_cast<size_t>(n));
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            close_fd(fd); // EOF 或读错误
+            return;
+        }
+    }
+};
 
-    while ((n = read(stdout_pipe[0], buf, sizeof(buf))) > 0) {
-        stdout_sink.append(reinterpret_cast<const uint8_t*>(buf), n);
+// 在当前线程屏蔽 SIGPIPE, 子进程提前退出时写管道只会得到 EPIPE 而不会杀死整个进程
+class SigpipeGuard {
+  public:
+    SigpipeGuard() {
+        sigemptyset(&set_);
+        sigaddset(&set_, SIGPIPE);
+        sigset_t pending;
+        sigpending(&pending);
+        was_pending_ = sigismember(&pending, SIGPIPE) == 1;
+        blocked_ = pthread_sigmask(SIG_BLOCK, &set_, &old_) == 0;
     }
-    close(stdout_pipe[0]);
 
-    while ((n = read(stderr_pipe[0], buf, sizeof(buf))) > 0) {
-        stderr_sink.append(reinterpret_cast<const uint8_t*>(buf), n);
+    ~SigpipeGuard() {
+        if (! blocked_) return;
+        if (! was_pending_) {
+            // 吃掉本次写入产生的 SIGPIPE, 再恢复原来的屏蔽字
+            struct timespec zero = {0, 0};
+            while (sigtimedwait(&set_, nullptr, &zero) > 0) {
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &old_, nullptr);
     }
-    close(stderr_pipe[0]);
 
-    int status;
-    if (waitpid(pid, &status, 0) < 0) return -3;
-    return WIFEXITED(status) ? WEXITSTATUS(status) : -4;
+  private:
+    sigset_t set_;
+    sigset_t old_;
+    bool was_pending_ = false;
+    bool blocked_ = false;
+};
+
+// stdout_fd >= 0 时子进程的 stdout 直接是该 fd, stdout_sink 不会收到数据
+template <typename StdoutSink, typename StderrSink>
+inline int run_command_sink(const std::vector<std::string>& argv,
+                            StdoutSink& stdout_sink,
+                            StderrSink& stderr_sink,
+                            const std::string* stdin_data = nullptr,
+                            const RunLimits& limits = RunLimits(),
+                            int stdout_fd = -1) {
+    SigpipeGuard guard;
+    PipeSession<StdoutSink, StderrSink> session(stdout_sink, stderr_sink);
+    session.redirect_stdout(stdout_fd);
+    int rc = session.start(argv, limits);
+    if (rc != 0) return rc;
+
+    // 写入 stdin 数据（如 DOT 字符串）
+    if (stdin_data && ! stdin_data->empty()) {
+        session.write_stdin(stdin_data->data(), stdin_data->size());
+    }
+    return session.finish();
 }
-} // namespace
 
-inline int run_command(const std::string& cmd, std::vector<uint8_t>& out_bin, std::vector<uint8_t>& err_bin) {
-    VectorSink out_sink(out_bin), err_sink(err_bin);
-    return run_command_sink(cmd, out_sink, err_sink);
+// 与 run_command_sink 相同, 但 stdin 内容由 produce 边生成边写入, 不需要先拼出完整字符串
+template <typename StdoutSink, typename StderrSink>
+inline int run_command_sink_streaming(const std::vector<std::string>& argv,
+                                      StdoutSink& stdout_sink,
+                                      StderrSink& stderr_sink,
+                                      const std::function<void(DotWriter&)>& produce,
+                                      const RunLimits& limits = RunLimits(),
+                                      int stdout_fd = -1) {
+    SigpipeGuard guard;
+    PipeSession<StdoutSink, StderrSink> session(stdout_sink, stderr_sink);
+    session.redirect_stdout(stdout_fd);
+    int rc = session.start(argv, limits);
+    if (rc != 0) return rc;
+
+    bool ok = true;
+    {
+        DotWriter writer([&](const char* data, size_t len) {
+            if (ok) ok = session.write_stdin(data, len);
+        });
+        produce(writer); // 异常时 session 析构会杀掉并回收子进程
+        writer.flush();
+    }
+    return session.finish();
 }
+} // namespace
 
-inline int run_command(const std::string& cmd, std::vector<uint8_t>& out_bin, std::string& err_text) {
+// 直接执行 argv[0] (不经过 shell), argv 中的参数原样传递, 无需任何引号转义
+inline int run_command(const std::vector<std::string>& argv,
+                       std::vector<uint8_t>& out_bin,
+                       std::string& err_text,
+                       const RunLimits& limits = RunLimits()) {
     VectorSink out_sink(out_bin);
     StringSink err_sink(err_text);
-    return run_command_sink(cmd, out_sink, err_sink);
+    return run_command_sink(argv, out_sink, err_sink, nullptr, limits);
 }
 
-inline int run_command(const std::string& cmd, std::string& out_text, std::string& err_text) {
+inline int run_command(const std::vector<std::string>& argv,
+                       std::string& out_text,
+                       std::string& err_text,
+                       const RunLimits& limits = RunLimits()) {
     StringSink out_sink(out_text), err_sink(err_text);
-    return run_command_sink(cmd, out_sink, err_sink);
+    return run_command_sink(argv, out_sink, err_sink, nullptr, limits);
+}
+
+// 以下字符串形式保留原有语义: 命令行交给 /bin/sh -c 解释
+inline std::vector<std::string> shell_argv(const std::string& cmd) {
+    return {"/bin/sh", "-c", cmd};
+}
+
+inline int run_command(const std::string& cmd,
+                       std::vector<uint8_t>& out_bin,
+                       std::vector<uint8_t>& err_bin,
+                       const RunLimits& limits = RunLimits()) {
+    VectorSink out_sink(out_bin), err_sink(err_bin);
+    return run_command_sink(shell_argv(cmd), out_sink, err_sink, nullptr, limits);
+}
+
+inline int run_command(const std::string& cmd,
+                       std::vector<uint8_t>& out_bin,
+                       std::string& err_text,
+                       const RunLimits& limits = RunLimits()) {
+    return run_command(shell_argv(cmd), out_bin, err_text, limits);
+}
+
+inline int run_command(const std::string& cmd,
+                       std::string& out_text,
+                       std::string& err_text,
+                       const RunLimits& limits = RunLimits()) {
+    return run_command(shell_argv(cmd), out_text, err_text, limits);
+}
+
+inline int run_command_with_producer(const std::function<void(DotWriter&)>& produce,
+                                     const std::vector<std::string>& argv,
+                                     std::vector<uint8_t>& stdout_output,
+                                     std::string& stderr_output,
+                                     const RunLimits& limits = RunLimits()) {
+    VectorSink out(stdout_output);
+    StringSink err(stderr_output);
+    return run_command_sink_streaming(argv, out, err, produce, limits);
 }
 
 inline int run_command_with_stdin(const std::string& stdin_data,
-                                  const std::string& cmd,
+                                  const std::vector<std::string>& argv,
                                   std::vector<uint8_t>& stdout_output,
-                                  std::string& stderr_output) {
+                                  std::string& stderr_output,
+                                  const RunLimits& limits = RunLimits()) {
     VectorSink out(stdout_output);
     StringSink err(stderr_output);
-    return run_command_sink(cmd, out, err, &stdin_data);
+    return run_command_sink(argv, out, err, &stdin_data, limits);
+}
+
+// 输出交给任意 ByteSink, 按读到的块转发
+template <typename Sink>
+inline int run_command_with_producer_to_sink(const std::function<void(DotWriter&)>& produce,
+                                             const std::vector<std::string>& argv,
+                                             ByteSink<Sink>& stdout_sink,
+                                             std::string& stderr_output,
+                                             const RunLimits& limits = RunLimits()) {
+    StringSink err(stderr_output);
+    return run_command_sink_streaming(argv, static_cast<Sink&>(stdout_sink), err, produce, limits);
+}
+
+template <typename Sink>
+inline int run_command_with_stdin_to_sink(const std::string& stdin_data,
+                                          const std::vector<std::string>& argv,
+                                          ByteSink<Sink>& stdout_sink,
+                                          std::string& stderr_output,
+                                          const RunLimits& limits = RunLimits()) {
+    StringSink err(stderr_output);
+    return run_command_sink(argv, static_cast<Sink&>(stdout_sink), err, &stdin_data, limits);
+}
+
+// 子进程的 stdout 直接是 out_fd (文件、管道、socket), 输出不经过本进程, 也不需要 splice/sendfile
+inline int run_command_with_producer_to_fd(const std::function<void(DotWriter&)>& produce,
+                                           const std::vector<std::string>& argv,
+                                           int out_fd,
+                                           std::string& stderr_output,
+                                           const RunLimits& limits = RunLimits()) {
+    std::vector<uint8_t> unused;
+    VectorSink out(unused);
+    StringSink err(stderr_output);
+    return run_command_sink_streaming(argv, out, err, produce, limits, out_fd);
 }
 
+inline int run_command_with_stdin_to_fd(const std::string& stdin_data,
+                                        const std::vector<std::string>& argv,
+                                        int out_fd,
+                                        std::string& stderr_output,
+                                        const RunLimits& limits = RunLimits()) {
+    std::vector<uint8_t> unused;
+    VectorSink out(unused);
+    StringSink err(stderr_output);
+    return run_command_sink(argv, out, err, &stdin_data, limits, out_fd);
+}
+
+inline int run_command_with_stdin(const std::string& stdin_data,
+                                  const std::string& cmd,
+                                  std::vector<uint8_t>& stdout_output,
+                                  std::string& stderr_output,
+                                  const RunLimits& limits = RunLimits()) {
+    return run_command_with_stdin(stdin_data, shell_argv(cmd), stdout_output, stderr_output, limits);
+}
+
+// 把 argv 格式化成可读 (且可粘贴到 shell) 的命令行, 仅用于错误信息
+inline std::string format_command(const std::vector<std::string>& argv) {
+    std::string out;
+    for (size_t i = 0; i < argv.size(); ++i) {
+        if (i) out += ' ';
+        const std::string& a = argv[i];
+        bool plain = ! a.empty() && a.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                                        "0123456789-_./:=+,@%") == std::string::npos;
+        if (plain) {
+            out += a;
+            continue;
+        }
+        out += '\'';
+        for (char ch : a) {
+            if (ch == '\'')
+                out += "'\\''";
+            else
+                out += ch;
+        }
+        out += '\'';
+    }
+    return out;
+}
 
 } // namespace kgraphviz
@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace kgraphviz {
+
+const static size_t SerializationChunkSize = 512; // 每块包含的 statement 数
+
+// 全局递增的版本号, 图的每次修改都取一个新值, 因此 "子图中最大的版本号" 可以表示整棵子树是否变过
+inline uint64_t next_graph_version() {
+    static std::atomic<uint64_t> counter(0);
+    return ++counter;
+}
+
+// BaseGraph 的分块序列化缓存: statements 按 SerializationChunkSize 分块, 每块缓存已序列化的文本,
+// 修改只让所在的块失效. 块中含子图时同时记录子图当时的版本, 子图变化后该块重新生成.
+// 拷贝/移动得到的是空缓存 (保留开关), 第一次输出时重新填充
+class SerializationCache {
+  public:
+    struct Chunk {
+        std::string text;
+        bool valid = false;
+        uint64_t subgraph_version = 0;  // 生成 text 时块内子图的最大版本
+        std::vector<uint32_t> subgraphs; // 块内 Subgraph statement 引用的下标
+    };
+
+    SerializationCache() = default;
+
+    SerializationCache(const SerializationCache& other) : enabled_(other.enabled_) {}
+
+    SerializationCache& operator=(const SerializationCache& other) {
+        if (this != &other) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            enabled_ = other.enabled_;
+            chunks_.clear();
+            indent_ = -1;
+        }
+        return *this;
+    }
+
+    bool enabled() const {
+        return enabled_;
+    }
+
+    void set_enabled(bool on) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        enabled_ = on;
+        if (! on) {
+            chunks_.clear();
+            chunks_.shrink_to_fit();
+        }
+    }
+
+    // 第 index 条 statement 被添加或修改
+    void invalidate(size_t index) {
+        if (! enabled_) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t c = index / SerializationChunkSize;
+        if (c < chunks_.size()) chunks_[c].valid = false;
+    }
+
+    // 以下由持有 mutex() 的 BaseGraph::write 使用
+    std::mutex& mutex() const {
+        return mutex_;
+    }
+
+    // 缓存的文本依赖缩进; 缩进变化时整体失效. 返回至少 n_chunks 块
+    std::vector<Chunk>& chunks(size_t n_chunks, int indent) {
+        if (indent != indent_) {
+            chunks_.clear();
+            indent_ = indent;
+        }
+        if (chunks_.size() < n_chunks) chunks_.resize(n_chunks);
+        return chunks_;
+    }
+
+  private:
+    bool enabled_ = false;
+    int indent_ = -1;
+    std::vector<Chunk> chunks_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace kgraphviz
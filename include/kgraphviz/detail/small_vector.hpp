@@ -0,0 +1,198 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace kgraphviz {
+
+// 前 N 个元素存放在对象内部的 vector, 超出后才分配堆内存. 只提供本库用到的接口
+template <typename T, size_t N>
+class SmallVector {
+    static_assert(N > 0, "SmallVector needs at least one inline slot");
+
+  public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+    using size_type = size_t;
+
+    SmallVector() : data_(inline_data()), size_(0), capacity_(N) {}
+
+    SmallVector(std::initializer_list<T> init) : SmallVector() {
+        reserve(init.size());
+        for (const auto& v : init) push_back(v);
+    }
+
+    SmallVector(const SmallVector& other) : SmallVector() {
+        reserve(other.size_);
+        for (const auto& v : other) push_back(v);
+    }
+
+    SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value) : SmallVector() {
+        take(other);
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            clear();
+            reserve(other.size_);
+            for (const auto& v : other) push_back(v);
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+        if (this != &other) {
+            clear();
+            free_heap();
+            take(other);
+        }
+        return *this;
+    }
+
+    ~SmallVector() {
+        clear();
+        free_heap();
+    }
+
+    iterator begin() {
+        return data_;
+    }
+    iterator end() {
+        return data_ + size_;
+    }
+    const_iterator begin() const {
+        return data_;
+    }
+    const_iterator end() const {
+        return data_ + size_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // 元素是否还在对象内部 (未分配堆内存)
+    bool is_inline() const {
+        return data_ == inline_data();
+    }
+
+    T& operator[](size_t i) {
+        return data_[i];
+    }
+    const T& operator[](size_t i) const {
+        return data_[i];
+    }
+
+    T& back() {
+        return data_[size_ - 1];
+    }
+
+    void reserve(size_t n) {
+        if (n <= capacity_) return;
+        T* fresh = static_cast<T*>(::operator new(n * sizeof(T)));
+        for (size_t i = 0; i < size_; ++i) {
+            new (fresh + i) T(std::move(data_[i]));
+            data_[i].~T();
+        }
+        free_heap();
+        data_ = fresh;
+        capacity_ = n;
+    }
+
+    void push_back(const T& v) {
+        emplace_back(v);
+    }
+
+    void push_back(T&& v) {
+        emplace_back(std::move(v));
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (size_ == capacity_) {
+            // 先构造再扩容, args 可能引用本容器中的元素
+            T tmp(std::forward<Args>(args)...);
+            reserve(capacity_ * 2);
+            new (data_ + size_) T(std::move(tmp));
+        } else {
+            new (data_ + size_) T(std::forward<Args>(args)...);
+        }
+        return data_[size_++];
+    }
+
+    // 在 pos 处插入, 之后的元素后移
+    iterator insert(const_iterator pos, T&& v) {
+        size_t idx = static_cast<size_t>(pos - data_);
+        emplace_back(std::move(v));
+        for (size_t i = size_ - 1; i > idx; --i) {
+            std::swap(data_[i], data_[i - 1]);
+        }
+        return data_ + idx;
+    }
+
+    iterator erase(const_iterator pos) {
+        size_t idx = static_cast<size_t>(pos - data_);
+        for (size_t i = idx; i + 1 < size_; ++i) {
+            data_[i] = std::move(data_[i + 1]);
+        }
+        data_[--size_].~T();
+        return data_ + idx;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < size_; ++i) data_[i].~T();
+        size_ = 0;
+    }
+
+  private:
+    T* data_;
+    size_t size_;
+    size_t capacity_;
+    typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type inline_;
+
+    T* inline_data() {
+        return reinterpret_cast<T*>(&inline_);
+    }
+    const T* inline_data() const {
+        return reinterpret_cast<const T*>(&inline_);
+    }
+
+    void free_heap() {
+        if (! is_inline()) ::operator delete(data_);
+        data_ = inline_data();
+        capacity_ = N;
+    }
+
+    // 要求本对象为空且使用内部存储
+    void take(SmallVector& other) {
+        if (other.is_inline()) {
+            for (size_t i = 0; i < other.size_; ++i) {
+                new (data_ + i) T(std::move(other.data_[i]));
+            }
+            size_ = other.size_;
+            other.clear();
+        } else {
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.data_ = other.inline_data();
+            other.size_ = 0;
+            other.capacity_ = N;
+        }
+    }
+};
+
+} // namespace kgraphviz
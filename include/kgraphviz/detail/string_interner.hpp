@@ -0,0 +1,172 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "arena.hpp"
+
+namespace kgraphviz {
+
+// 不拥有内存的字符串引用. StringInterner 返回的 StrRef 以 '\0' 结尾, 可以直接用 c_str()
+struct StrRef {
+    const char* data;
+    size_t size;
+
+    const char* c_str() const {
+        return data;
+    }
+
+    std::string str() const {
+        return std::string(data, size);
+    }
+
+    bool empty() const {
+        return size == 0;
+    }
+
+    const char* begin() const {
+        return data;
+    }
+
+    const char* end() const {
+        return data + size;
+    }
+
+    bool operator==(const StrRef& o) const {
+        return size == o.size && (size == 0 || std::memcmp(data, o.data, size) == 0);
+    }
+
+    bool operator!=(const StrRef& o) const {
+        return ! (*this == o);
+    }
+
+    bool operator==(const std::string& s) const {
+        return *this == StrRef{s.data(), s.size()};
+    }
+
+    bool operator!=(const std::string& s) const {
+        return ! (*this == s);
+    }
+};
+
+struct StrRefHash {
+    size_t operator()(const StrRef& s) const {
+        // FNV-1a
+        uint64_t h = 1469598103934665603ULL;
+        for (size_t i = 0; i < s.size; ++i) {
+            h ^= static_cast<unsigned char>(s.data[i]);
+            h *= 1099511628211ULL;
+        }
+        return static_cast<size_t>(h);
+    }
+};
+
+// 字符串驻留表: 相同内容只保存一份, 用 32 位 ID 引用. 字符和索引都分配在 MonotonicArena 中.
+// ID 按首次出现的顺序分配, 从 0 开始; 已分配的 ID 和 str() 返回的 StrRef 在整个生命周期内有效
+class StringInterner {
+  public:
+    using Id = uint32_t;
+
+    // arena 为空时使用私有 arena; 传入的 arena 与拷贝出的驻留表共享
+    explicit StringInterner(const std::shared_ptr<MonotonicArena>& arena = nullptr)
+        : owns_arena_(! arena),
+          arena_(arena ? arena : std::make_shared<MonotonicArena>(4096)),
+          strings_(ArenaAllocator<StrRef>(arena_.get())),
+          index_(16, StrRefHash(), std::equal_to<StrRef>(), IndexAllocator(arena_.get())) {}
+
+    // 共享 arena 时字符仍然有效, 直接复制引用; 私有 arena 则复制到新的 arena 中
+    StringInterner(const StringInterner& other)
+        : owns_arena_(other.owns_arena_),
+          arena_(other.owns_arena_ ? std::make_shared<MonotonicArena>(4096) : other.arena_),
+          strings_(ArenaAllocator<StrRef>(arena_.get())),
+          index_(other.index_.size() + 16, StrRefHash(), std::equal_to<StrRef>(), IndexAllocator(arena_.get())) {
+        if (owns_arena_) {
+            strings_.reserve(other.strings_.size());
+            for (const auto& s : other.strings_) {
+                intern(s.data, s.size);
+            }
+        } else {
+            strings_ = other.strings_;
+            index_ = other.index_;
+        }
+    }
+
+    StringInterner& operator=(const StringInterner& other) {
+        if (this != &other) {
+            StringInterner tmp(other);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    // 被移走的对象换上一个空的私有 arena, 仍然可以继续使用
+    StringInterner(StringInterner&& other) noexcept : StringInterner() {
+        *this = std::move(other);
+    }
+
+    // 不能逐成员赋值: 先替换 arena_ 会在旧索引析构前释放它的内存
+    StringInterner& operator=(StringInterner&& other) noexcept {
+        std::swap(owns_arena_, other.owns_arena_);
+        strings_.swap(other.strings_);
+        index_.swap(other.index_);
+        arena_.swap(other.arena_);
+        return *this;
+    }
+
+    Id intern(const std::string& s) {
+        return intern(s.data(), s.size());
+    }
+
+    Id intern(const char* data, size_t size) {
+        auto it = index_.find(StrRef{data, size});
+        if (it != index_.end()) return it->second;
+
+        char* copy = static_cast<char*>(arena_->allocate(size + 1, 1));
+        if (size != 0) std::memcpy(copy, data, size);
+        copy[size] = '\0';
+
+        Id id = static_cast<Id>(strings_.size());
+        strings_.push_back(StrRef{copy, size});
+        index_.emplace(strings_.back(), id);
+        return id;
+    }
+
+    void reserve(size_t n) {
+        strings_.reserve(n);
+        index_.reserve(n);
+    }
+
+    // 只查找不插入
+    bool find(const std::string& s, Id& id) const {
+        auto it = index_.find(StrRef{s.data(), s.size()});
+        if (it == index_.end()) return false;
+        id = it->second;
+        return true;
+    }
+
+    StrRef str(Id id) const {
+        return strings_[id];
+    }
+
+    size_t size() const {
+        return strings_.size();
+    }
+
+    const std::shared_ptr<MonotonicArena>& arena() const {
+        return arena_;
+    }
+
+  private:
+    using IndexAllocator = ArenaAllocator<std::pair<const StrRef, Id>>;
+
+    bool owns_arena_;
+    std::shared_ptr<MonotonicArena> arena_; // 最先构造, 最后析构
+    ArenaVector<StrRef> strings_;
+    std::unordered_map<StrRef, Id, StrRefHash, std::equal_to<StrRef>, IndexAllocator> index_;
+};
+
+} // namespace kgraphviz
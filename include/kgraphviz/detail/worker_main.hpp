@@ -0,0 +1,58 @@
+#pragma once
+#include <exception>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+
+#include "gvc_backend.hpp"
+#include "worker_protocol.hpp"
+#include "../options.hpp"
+
+#ifndef KGRAPHVIZ_WITH_GVC
+#error "worker_main.hpp requires -DKGRAPHVIZ_WITH_GVC (link with -lgvc -lcgraph)"
+#endif
+
+namespace kgraphviz {
+
+// 常驻 worker 的主循环: 从 stdin 读取请求帧, 用 libgvc 渲染, 把结果帧写到 stdout.
+// GVC 上下文和插件只在第一次渲染时加载一次. stdin 关闭 (WorkerPool 析构) 时返回 0
+inline int worker_main() {
+    // 父进程退出后写 stdout 得到 EPIPE, 由返回值处理而不是被信号杀死
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<std::string> fields;
+    for (;;) {
+        worker_protocol::IoResult r = worker_protocol::read_request(STDIN_FILENO, fields);
+        if (r == worker_protocol::IoEof) return 0;
+        if (r != worker_protocol::IoOk || fields.empty()) return 1;
+
+        if (fields[0] == "ping") {
+            if (worker_protocol::write_response(STDOUT_FILENO, true, "", 0) != worker_protocol::IoOk) return 1;
+            continue;
+        }
+
+        std::vector<uint8_t> out;
+        std::string error;
+        if (fields[0] != "render" || fields.size() != 7) {
+            error = "kgraphviz_worker: malformed request";
+        } else {
+            RenderOptions options;
+            options.set_engine(fields[1]).set_format(fields[2]).set_renderer(fields[3]).set_formatter(fields[4]);
+            options.set_neato_no_op(! fields[5].empty(), fields[5] == "n2" ? 2 : 1);
+            try {
+                out = GvcRenderer::render_source(fields[6], options);
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+        }
+
+        worker_protocol::IoResult w =
+            error.empty() ? worker_protocol::write_response(
+                                STDOUT_FILENO, true, reinterpret_cast<const char*>(out.data()), out.size())
+                          : worker_protocol::write_response(STDOUT_FILENO, false, error.data(), error.size());
+        if (w != worker_protocol::IoOk) return 1;
+    }
+}
+
+} // namespace kgraphviz
@@ -0,0 +1,346 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "executable_resolver.hpp"
+#include "run_command.hpp"
+#include "worker_protocol.hpp"
+#include "../exceptions.hpp"
+#include "../options.hpp"
+
+namespace kgraphviz {
+
+// 一组常驻的渲染 worker 进程 (见 kgraphviz_worker.cpp / detail/worker_main.hpp).
+// 每个 worker 只加载一次 Graphviz 插件与配置, 之后通过管道上的帧协议接收 DOT 并返回渲染结果,
+// 省掉每次渲染启动 dot 的开销. worker 崩溃时自动重启, health_check() 可主动探测.
+class WorkerPool {
+  public:
+    explicit WorkerPool(const std::string& worker_path, size_t size = 0) : worker_path_(worker_path) {
+        if (size == 0) {
+            size = std::thread::hardware_concurrency();
+            if (size == 0) size = 1;
+        }
+
+        resolved_path_ = ExecutableResolver::resolve(worker_path);
+        if (resolved_path_.empty()) {
+            throw ExecutableNotFound(worker_path);
+        }
+
+        workers_.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            if (! spawn(workers_[i])) {
+                shutdown();
+                throw ExecutableNotFound(worker_path + " (failed to spawn worker)");
+            }
+            idle_.push_back(i);
+        }
+    }
+
+    ~WorkerPool() {
+        shutdown();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t size() const {
+        return workers_.size();
+    }
+
+    // 累计重启过的 worker 数
+    uint64_t respawn_count() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return respawns_;
+    }
+
+    // 在空闲 worker 上渲染; 没有空闲 worker 时阻塞等待, 等待时间计入 timeout_ms 并响应取消.
+    // worker 在处理过程中崩溃会换一个新进程重试一次
+    std::vector<uint8_t> render(const std::string& dot_source, const RenderOptions& options) {
+        if (options.format.empty()) {
+            throw RequiredArgumentError("format");
+        }
+
+        const std::string op = "render";
+        const std::string neato = options.neato_no_op ? options.neato_no_op_arg().substr(1) : "";
+        std::vector<const std::string*> fields = {
+            &op, &options.engine, &options.format, &options.renderer, &options.formatter, &neato, &dot_source};
+
+        worker_protocol::IoLimits limits;
+        limits.cancel = options.cancel_token.get();
+        limits.has_deadline = options.timeout_ms > 0;
+        if (limits.has_deadline) {
+            limits.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeout_ms);
+        }
+
+        Lease lease(*this, limits, options.timeout_ms);
+        Worker& w = workers_[lease.index];
+        SigpipeGuard guard;
+
+        for (int attempt = 0;; ++attempt) {
+            if (w.pid < 0 && ! respawn(w)) {
+                throw CalledProcessError(-2, command(), "", "failed to respawn worker");
+            }
+
+            bool ok = false;
+            std::vector<uint8_t> payload;
+            worker_protocol::IoResult r = worker_protocol::write_request(w.in_fd, fields, limits);
+            if (r == worker_protocol::IoOk) {
+                r = worker_protocol::read_response(w.out_fd, ok, payload, limits);
+            }
+
+            switch (r) {
+                case worker_protocol::IoOk:
+                    if (! ok) {
+                        std::string err(payload.begin(), payload.end());
+                        throw CalledProcessError(1, command(), "<ignored>", options.quiet ? "" : err);
+                    }
+                    return payload;
+
+                case worker_protocol::IoTimedOut:
+                    // worker 正忙于这次布局, 只能杀掉; 下次使用时重启
+                    terminate(w);
+                    throw TimeoutExpired(command(), options.timeout_ms);
+
+                case worker_protocol::IoCancelled:
+                    terminate(w);
+                    throw RenderCancelled(command());
+
+                default:
+                    // 管道断开或协议损坏: worker 已崩溃
+                    int status = terminate(w);
+                    if (attempt >= 1) {
+                        throw CalledProcessError(status, command(), "", "worker crashed while rendering");
+                    }
+                    break;
+            }
+        }
+    }
+
+    // ping 所有空闲 worker, 重启没有响应的; 返回重启的数量
+    size_t health_check(long timeout_ms = 1000) {
+        std::vector<size_t> checked;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            checked.swap(idle_);
+        }
+
+        SigpipeGuard guard;
+        size_t restarted = 0;
+        const std::string op = "ping";
+        std::vector<const std::string*> fields = {&op};
+        for (size_t idx : checked) {
+            Worker& w = workers_[idx];
+            worker_protocol::IoLimits limits;
+            limits.has_deadline = true;
+            limits.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+            bool ok = false;
+            std::vector<uint8_t> payload;
+            bool alive = w.pid > 0 &&
+                         worker_protocol::write_request(w.in_fd, fields, limits) == worker_protocol::IoOk &&
+                         worker_protocol::read_response(w.out_fd, ok, payload, limits) == worker_protocol::IoOk && ok;
+            if (! alive) {
+                terminate(w);
+                respawn(w);
+                ++restarted;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            idle_.insert(idle_.end(), checked.begin(), checked.end());
+        }
+        cv_.notify_all();
+        return restarted;
+    }
+
+  private:
+    struct Worker {
+        pid_t pid = -1;
+        int in_fd = -1;  // worker 的 stdin
+        int out_fd = -1; // worker 的 stdout
+    };
+
+    // 独占一个空闲 worker, 析构时归还. 等到截止时间仍没有空闲 worker 抛 TimeoutExpired, 被取消抛 RenderCancelled
+    struct Lease {
+        WorkerPool& pool;
+        size_t index;
+
+        Lease(WorkerPool& p, const worker_protocol::IoLimits& limits, long timeout_ms) : pool(p) {
+            using Clock = std::chrono::steady_clock;
+            std::unique_lock<std::mutex> lock(pool.mutex_);
+            while (pool.idle_.empty()) {
+                if (limits.cancel && limits.cancel->cancelled()) throw RenderCancelled(pool.command());
+                if (limits.has_deadline && Clock::now() >= limits.deadline) {
+                    throw TimeoutExpired(pool.command(), timeout_ms);
+                }
+                if (! limits.cancel && ! limits.has_deadline) {
+                    pool.cv_.wait(lock);
+                    continue;
+                }
+                // 取消不会唤醒 cv_, 有取消令牌时按短间隔醒来检查
+                Clock::time_point until = limits.has_deadline ? limits.deadline : Clock::time_point::max();
+                if (limits.cancel) until = std::min(until, Clock::now() + std::chrono::milliseconds(20));
+                pool.cv_.wait_until(lock, until);
+            }
+            index = pool.idle_.back();
+            pool.idle_.pop_back();
+        }
+
+        ~Lease() {
+            {
+                std::lock_guard<std::mutex> lock(pool.mutex_);
+                pool.idle_.push_back(index);
+            }
+            pool.cv_.notify_one();
+        }
+    };
+
+    std::string worker_path_;
+    std::string resolved_path_;
+    std::vector<Worker> workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<size_t> idle_;
+    uint64_t respawns_ = 0;
+
+    std::string command() const {
+        return "worker " + worker_path_;
+    }
+
+    static int make_pipe(int p[2]) {
+#if defined(__linux__)
+        return pipe2(p, O_CLOEXEC);
+#else
+        if (pipe(p) != 0) return -1;
+        fcntl(p[0], F_SETFD, FD_CLOEXEC);
+        fcntl(p[1], F_SETFD, FD_CLOEXEC);
+        return 0;
+#endif
+    }
+
+    bool spawn(Worker& w) {
+        int in_pipe[2], out_pipe[2];
+        if (make_pipe(in_pipe) != 0) return false;
+        if (make_pipe(out_pipe) != 0) {
+            close(in_pipe[0]);
+            close(in_pipe[1]);
+            return false;
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+        // 错误信息通过协议返回, worker 的 stderr 丢弃
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        sigset_t empty_mask, default_signals;
+        sigemptyset(&empty_mask);
+        sigemptyset(&default_signals);
+        sigaddset(&default_signals, SIGPIPE);
+        posix_spawnattr_setsigmask(&attr, &empty_mask);
+        posix_spawnattr_setsigdefault(&attr, &default_signals);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+        char* argv[] = {const_cast<char*>(resolved_path_.c_str()), nullptr};
+        pid_t pid = -1;
+        int rc = posix_spawn(&pid, resolved_path_.c_str(), &actions, &attr, argv, environ);
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+
+        close(in_pipe[0]);
+        close(out_pipe[1]);
+        if (rc != 0) {
+            close(in_pipe[1]);
+            close(out_pipe[0]);
+            return false;
+        }
+
+        w.pid = pid;
+        w.in_fd = in_pipe[1];
+        w.out_fd = out_pipe[0];
+        // 非阻塞, 配合 worker_protocol 的 poll 实现超时与取消
+        fcntl(w.in_fd, F_SETFL, fcntl(w.in_fd, F_GETFL) | O_NONBLOCK);
+        fcntl(w.out_fd, F_SETFL, fcntl(w.out_fd, F_GETFL) | O_NONBLOCK);
+        return true;
+    }
+
+    bool respawn(Worker& w) {
+        if (! spawn(w)) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++respawns_;
+        return true;
+    }
+
+    // 杀掉并回收 worker, 返回其退出码 (被信号杀死时为 -4)
+    static int terminate(Worker& w) {
+        if (w.in_fd >= 0) close(w.in_fd);
+        if (w.out_fd >= 0) close(w.out_fd);
+        w.in_fd = w.out_fd = -1;
+
+        int code = -3;
+        if (w.pid > 0) {
+            ::kill(w.pid, SIGKILL);
+            int status = 0;
+            while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR) {
+            }
+            code = WIFEXITED(status) ? WEXITSTATUS(status) : -4;
+        }
+        w.pid = -1;
+        return code;
+    }
+
+    // 非阻塞地回收已退出的 worker
+    static bool try_reap(Worker& w) {
+        int status = 0;
+        pid_t r = waitpid(w.pid, &status, WNOHANG);
+        if (r == 0 || (r < 0 && errno == EINTR)) return false;
+        w.pid = -1;
+        return true;
+    }
+
+    void shutdown() {
+        // 关闭 stdin 后 worker 读到 EOF 会自行退出
+        for (auto& w : workers_) {
+            if (w.in_fd >= 0) close(w.in_fd);
+            if (w.out_fd >= 0) close(w.out_fd);
+            w.in_fd = w.out_fd = -1;
+        }
+        // 给它们一小段时间; 仍未退出的 (如卡在一次很慢的布局中) 直接杀掉并回收
+        const long grace_ms = 500;
+        std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(grace_ms);
+        for (auto& w : workers_) {
+            while (w.pid > 0 && ! try_reap(w) && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            if (w.pid > 0) terminate(w);
+        }
+    }
+};
+
+// RenderBackend::Worker 下取出 options 中的 worker 池, 未设置时报错
+inline WorkerPool& worker_pool_of(const RenderOptions& options) {
+    if (! options.worker_pool) {
+        throw RequiredArgumentError("worker_pool (required by RenderBackend::Worker)");
+    }
+    return *options.worker_pool;
+}
+
+} // namespace kgraphviz
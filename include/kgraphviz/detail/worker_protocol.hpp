@@ -0,0 +1,183 @@
+#pragma once
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+
+#include "cancel_token.hpp"
+
+namespace kgraphviz {
+
+// 常驻 worker 进程与 WorkerPool 之间的帧格式 (小端):
+//   请求: "KGW1" u32 字段数, 每个字段 u64 长度 + 字节; 第一个字段是操作名 ("render" / "ping")
+//         render 的其余字段依次为 engine, format, renderer, formatter, neato_no_op("n"/"n2"/""), DOT 文本
+//   响应: "KGR1" u8 状态 (0 成功, 1 失败) u64 长度 + 负载 (输出字节或错误信息)
+namespace worker_protocol {
+
+const static char RequestMagic[4] = {'K', 'G', 'W', '1'};
+const static char ResponseMagic[4] = {'K', 'G', 'R', '1'};
+
+// 单个字段的长度上限 (1 GiB); 超过时视为损坏的帧, 避免按垃圾长度分配内存
+const static uint64_t MaxFieldSize = 1ULL << 30;
+
+// 响应负载 (渲染输出) 的长度上限 (4 GiB); 超过时同样视为损坏的帧, 走 IoError 的重试路径
+const static uint64_t MaxPayloadSize = 1ULL << 32;
+
+enum IoResult {
+    IoOk = 0,
+    IoEof,       // 对端关闭 (worker 崩溃或退出)
+    IoError,
+    IoTimedOut,
+    IoCancelled
+};
+
+// 带截止时间与取消的 I/O 等待; 没有截止时间且没有取消令牌时无限等待
+struct IoLimits {
+    bool has_deadline = false;
+    std::chrono::steady_clock::time_point deadline;
+    const CancelToken* cancel = nullptr;
+};
+
+inline IoResult wait_fd(int fd, short events, const IoLimits& limits) {
+    for (;;) {
+        if (limits.cancel && limits.cancel->cancelled()) return IoCancelled;
+
+        int timeout = -1;
+        if (limits.has_deadline) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(limits.deadline -
+                                                                              std::chrono::steady_clock::now())
+                            .count();
+            if (left <= 0) return IoTimedOut;
+            timeout = left > (1 << 30) ? (1 << 30) : static_cast<int>(left);
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = fd;
+        fds[0].events = events;
+        fds[0].revents = 0;
+        fds[1].fd = limits.cancel ? limits.cancel->fd() : -1;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        if (limits.cancel && fds[1].fd < 0 && (timeout < 0 || timeout > 50)) timeout = 50;
+
+        int rc = ::poll(fds, 2, timeout);
+        if (rc < 0) {
+            if (errno == EINTR) continue;
+            return IoError;
+        }
+        if (fds[0].revents) return IoOk;
+    }
+}
+
+inline IoResult write_all(int fd, const char* data, size_t len, const IoLimits& limits = IoLimits()) {
+    while (len > 0) {
+        IoResult w = wait_fd(fd, POLLOUT, limits);
+        if (w != IoOk) return w;
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return errno == EPIPE ? IoEof : IoError;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return IoOk;
+}
+
+inline IoResult read_exact(int fd, char* data, size_t len, const IoLimits& limits = IoLimits()) {
+    while (len > 0) {
+        IoResult w = wait_fd(fd, POLLIN, limits);
+        if (w != IoOk) return w;
+        ssize_t n = ::read(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return IoError;
+        }
+        if (n == 0) return IoEof;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return IoOk;
+}
+
+inline void put_u64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+inline uint64_t get_u64(const char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+inline uint32_t get_u32(const char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+// 除最后一个字段外都先拼进头部; 最后一个 (通常是 DOT 文本) 单独写出, 避免复制大字段
+inline IoResult
+write_request(int fd, const std::vector<const std::string*>& fields, const IoLimits& limits = IoLimits()) {
+    std::string head(RequestMagic, 4);
+    uint32_t count = static_cast<uint32_t>(fields.size());
+    for (int i = 0; i < 4; ++i) head.push_back(static_cast<char>((count >> (8 * i)) & 0xff));
+    for (size_t i = 0; i < fields.size(); ++i) {
+        put_u64(head, fields[i]->size());
+        if (i + 1 < fields.size()) head += *fields[i];
+    }
+    IoResult r = write_all(fd, head.data(), head.size(), limits);
+    if (r != IoOk || fields.empty()) return r;
+    const std::string& last = *fields.back();
+    return write_all(fd, last.data(), last.size(), limits);
+}
+
+inline IoResult read_request(int fd, std::vector<std::string>& fields) {
+    char head[8];
+    IoResult r = read_exact(fd, head, sizeof(head));
+    if (r != IoOk) return r;
+    if (std::memcmp(head, RequestMagic, 4) != 0) return IoError;
+
+    uint32_t count = get_u32(head + 4);
+    if (count > 64) return IoError; // 协议里不会有这么多字段, 视为损坏的帧
+    fields.assign(count, std::string());
+    for (auto& f : fields) {
+        char len_buf[8];
+        if ((r = read_exact(fd, len_buf, 8)) != IoOk) return r;
+        uint64_t len = get_u64(len_buf);
+        if (len > MaxFieldSize) return IoError;
+        f.resize(static_cast<size_t>(len));
+        if (! f.empty() && (r = read_exact(fd, &f[0], f.size())) != IoOk) return r;
+    }
+    return IoOk;
+}
+
+inline IoResult write_response(int fd, bool ok, const char* data, size_t len) {
+    std::string head(ResponseMagic, 4);
+    head.push_back(ok ? 0 : 1);
+    put_u64(head, len);
+    IoResult r = write_all(fd, head.data(), head.size());
+    if (r != IoOk) return r;
+    return write_all(fd, data, len);
+}
+
+inline IoResult read_response(int fd, bool& ok, std::vector<uint8_t>& payload, const IoLimits& limits = IoLimits()) {
+    char head[13];
+    IoResult r = read_exact(fd, head, sizeof(head), limits);
+    if (r != IoOk) return r;
+    if (std::memcmp(head, ResponseMagic, 4) != 0) return IoError;
+
+    ok = head[4] == 0;
+    uint64_t len = get_u64(head + 5);
+    if (len > MaxPayloadSize) return IoError;
+    payload.resize(static_cast<size_t>(len));
+    if (payload.empty()) return IoOk;
+    return read_exact(fd, reinterpret_cast<char*>(payload.data()), payload.size(), limits);
+}
+
+} // namespace worker_protocol
+} // namespace kgraphviz
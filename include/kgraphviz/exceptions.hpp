@@ -52,6 +52,43 @@ class CalledProcessError : public std::runtime_error {
     std::string message_;
 };
 
+// Raised when the engine is killed because RenderOptions::timeout_ms elapsed
+class TimeoutExpired : public std::runtime_error {
+  public:
+    TimeoutExpired(const std::string& cmd, long timeout_ms)
+        : std::runtime_error(""), command(cmd), timeout_ms(timeout_ms) {
+        std::ostringstream oss;
+        oss << "TimeoutExpired: Command `" << cmd << "` timed out after " << timeout_ms << " ms";
+        message_ = oss.str();
+    }
+
+    const char* what() const noexcept override {
+        return message_.c_str();
+    }
+
+    std::string command;
+    long timeout_ms;
+
+  private:
+    std::string message_;
+};
+
+// Raised when a render is aborted through its CancelToken / RenderHandle::cancel()
+class RenderCancelled : public std::runtime_error {
+  public:
+    explicit RenderCancelled(const std::string& cmd)
+        : std::runtime_error(""), command(cmd), message_("RenderCancelled: Command `" + cmd + "` was cancelled") {}
+
+    const char* what() const noexcept override {
+        return message_.c_str();
+    }
+
+    std::string command;
+
+  private:
+    std::string message_;
+};
+
 // Raised when required arguments are missing
 class RequiredArgumentError : public std::runtime_error {
   public:
@@ -94,4 +131,39 @@ class FileNotExistsError : public std::runtime_error {
     std::string message_;
 };
 
+// Raised when a RenderBackend is selected that this build does not provide
+class BackendNotAvailable : public std::runtime_error {
+  public:
+    explicit BackendNotAvailable(const std::string& msg)
+        : std::runtime_error(""), message_("BackendNotAvailable: " + msg) {}
+
+    const char* what() const noexcept override {
+        return message_.c_str();
+    }
+
+  private:
+    std::string message_;
+};
+
+// Raised when DOT text cannot be parsed; line and column are 1-based
+class DotSyntaxError : public std::runtime_error {
+  public:
+    DotSyntaxError(const std::string& msg, size_t line, size_t column)
+        : std::runtime_error(""), line(line), column(column) {
+        std::ostringstream oss;
+        oss << "DotSyntaxError: line " << line << ", column " << column << ": " << msg;
+        message_ = oss.str();
+    }
+
+    const char* what() const noexcept override {
+        return message_.c_str();
+    }
+
+    size_t line;
+    size_t column;
+
+  private:
+    std::string message_;
+};
+
 } // namespace kgraphviz
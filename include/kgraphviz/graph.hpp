@@ -1,273 +1,945 @@
 #pragma once
+#include <algorithm>
 #include <memory>
 #include <string>
-#include <map>
 #include <vector>
-#include <sstream>
 #include <utility>
+#include <fstream>
+#include <map>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "options.hpp"
 
+#include "detail/dot_writer.hpp"
+#include "detail/escape.hpp"
+#include "detail/arena.hpp"
+#include "detail/attr_map.hpp"
+#include "detail/layout.hpp"
+#include "detail/string_interner.hpp"
+#include "detail/serialization_cache.hpp"
 #include "detail/tmpfile.hpp"
 #include "detail/viewer.hpp"
 #include "detail/render.hpp"
+#include "detail/gvc_backend.hpp"
+#include "detail/render_cache.hpp"
+#include "detail/async_render.hpp"
+#include "detail/worker_pool.hpp"
 
 namespace kgraphviz {
-using AttrMap = std::map<std::string, std::string>;
+
+class DotParser;
+class ComponentSplitter;
 
 class BaseGraph {
+    friend class DotParser;         // 解析时直接写入驻留串与 statements, 不经过 std::string
+    friend class ComponentSplitter; // 拆分时复制默认属性与原样文本行
+
+    using Id = StringInterner::Id;
+
+    // 属性的 key / value 都是驻留串 ID
+    struct AttrPair {
+        Id key;
+        Id value;
+    };
+
+    // 紧凑的 statement 记录, 名字和属性都以 ID 形式引用 strings_ / attrs_
     struct Statement {
-        enum class Type {
+        enum class Type : uint8_t {
             RawLine,
             Node,
             Edge,
             Subgraph
         };
         Type type;
+        uint16_t attr_count; // 属性个数, 存放在 attrs_[attr_begin, attr_begin + attr_count)
+        Id a;                // RawLine: 文本; Node: 名字; Edge: tail; Subgraph: subgraphs_ 下标
+        Id b;                // Edge: head
+        uint32_t attr_begin;
 
-        // RawLine
-        std::string raw;
-
-        // Node
-        std::string node_name;
-        std::map<std::string, std::string> node_attrs;
-
-        // Edge
-        std::string tail, head;
-        std::map<std::string, std::string> edge_attrs;
-
-        // Subgraph
-        std::shared_ptr<BaseGraph> subgraph;
-
-        static Statement make_raw(const std::string& r) {
+        static Statement make(Type t, Id a, Id b = 0) {
             Statement s;
-            s.type = Type::RawLine;
-            s.raw = r;
+            s.type = t;
+            s.attr_count = 0;
+            s.a = a;
+            s.b = b;
+            s.attr_begin = 0;
             return s;
         }
 
-        static Statement make_node(const std::string& name, const std::map<std::string, std::string>& attrs) {
-            Statement s;
-            s.type = Type::Node;
-            s.node_name = name;
-            s.node_attrs = attrs;
-            return s;
+        static Statement make_raw(Id line) {
+            return make(Type::RawLine, line);
         }
 
-        static Statement
-        make_edge(const std::string& t, const std::string& h, const std::map<std::string, std::string>& attrs) {
-            Statement s;
-            s.type = Type::Edge;
-            s.tail = t;
-            s.head = h;
-            s.edge_attrs = attrs;
-            return s;
+        static Statement make_node(Id name) {
+            return make(Type::Node, name);
         }
 
-        static Statement make_subgraph(const std::shared_ptr<BaseGraph>& g) {
-            Statement s;
-            s.type = Type::Subgraph;
-            s.subgraph = g;
-            return s;
+        static Statement make_edge(Id tail, Id head) {
+            return make(Type::Edge, tail, head);
         }
 
-        std::string to_string(const BaseGraph& owner, int indent_level) const {
-            const std::string indent(indent_level * 4, ' ');
-            std::ostringstream oss;
+        static Statement make_subgraph(uint32_t index) {
+            return make(Type::Subgraph, index);
+        }
+    };
+    static_assert(sizeof(Statement) == 16, "Statement should stay compact");
 
-            switch (type) {
-                case Type::RawLine:
-                    oss << indent << raw << "\n";
-                    break;
+  public:
+    // 一条 statement 的属性, 元素与 AttrMap 的元素一样通过 first / second 访问, 按 key 有序
+    class AttrView {
+      public:
+        struct value_type {
+            StrRef first;
+            StrRef second;
+        };
 
-                case Type::Node:
-                    oss << indent << owner.escape_id(node_name);
-                    if (! node_attrs.empty()) {
-                        oss << " [" << owner.format_attrs(node_attrs) << "]";
-                    }
-                    oss << ";\n";
-                    break;
+        class const_iterator {
+          public:
+            const_iterator(const AttrPair* p, const StringInterner* strings) : p_(p), strings_(strings) {}
 
-                case Type::Edge:
-                    oss << indent << owner.escape_id(tail) << " " << owner.edge_op() << " " << owner.escape_id(head);
-                    if (! edge_attrs.empty()) {
-                        oss << " [" << owner.format_attrs(edge_attrs) << "]";
-                    }
-                    oss << ";\n";
-                    break;
+            value_type operator*() const {
+                return value_type{strings_->str(p_->key), strings_->str(p_->value)};
+            }
 
-                case Type::Subgraph:
-                    oss << subgraph->to_string(indent_level); // recursive
-                    break;
+            const_iterator& operator++() {
+                ++p_;
+                return *this;
+            }
+
+            bool operator!=(const const_iterator& o) const {
+                return p_ != o.p_;
             }
 
-            return oss.str();
+            bool operator==(const const_iterator& o) const {
+                return p_ == o.p_;
+            }
+
+          private:
+            const AttrPair* p_;
+            const StringInterner* strings_;
+        };
+
+        AttrView(const AttrPair* begin, size_t size, const StringInterner* strings)
+            : begin_(begin), size_(size), strings_(strings) {}
+
+        const_iterator begin() const {
+            return const_iterator(begin_, strings_);
+        }
+
+        const_iterator end() const {
+            return const_iterator(begin_ + size_, strings_);
         }
-    };
 
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+      private:
+        const AttrPair* begin_;
+        size_t size_;
+        const StringInterner* strings_;
+    };
 
   protected:
     std::string graph_name_;
     bool strict_ = false;
     bool directed_ = false;
+    bool cluster_ = true; // 作为子图输出时是否加 "cluster_" 前缀, 见 subgraph_id()
 
     std::string comment_;
     AttrMap graph_attr_;
     AttrMap node_attr_;
     AttrMap edge_attr_;
 
-    std::vector<Statement> statements_;
+    // 可选的 arena, 最先构造、最后析构. statements_ / attrs_ 的元素可平凡析构,
+    // 因此整体赋值时先替换 arena_ 也不会访问已释放的内存
+    std::shared_ptr<MonotonicArena> arena_;
+
+    ArenaVector<Statement> statements_;
+    ArenaVector<AttrPair> attrs_;                       // 所有 statement 的属性, 连续存放
+    std::vector<std::shared_ptr<BaseGraph>> subgraphs_; // Subgraph statement 通过下标引用
+    StringInterner strings_;                            // 节点名、属性 key/value 与原样文本
+
+    // 可选的节点/边去重索引, 见 enable_dedup()
+    struct DedupIndex {
+        enum : uint32_t { Implicit = 0xffffffffu }; // 只作为边端点出现, 没有 node statement
+
+        bool enabled = false;
+        std::unordered_map<Id, uint32_t> nodes;       // 名字 -> node statement 下标
+        std::unordered_map<uint64_t, uint32_t> edges; // (tail, head) -> 第一条 edge statement 下标
+        size_t edge_count = 0;
+    };
+    DedupIndex dedup_;
+
+    uint64_t version_ = next_graph_version();   // 每次修改后更新
+    mutable SerializationCache serial_cache_; // 可选, 见 enable_serialization_cache()
 
-    std::string edge_op() const {
+    const char* edge_op() const {
         return directed_ ? "->" : "--";
     }
 
   public:
-    BaseGraph(const std::string& name = "G", bool strict = false, bool directed = false)
-        : graph_name_(name), strict_(strict), directed_(directed) {}
-
-    void set_graph_attr(const std::string& key, const std::string& value) {
-        graph_attr_[key] = value;
+    // 传入 arena 时 statements、属性和驻留串都从中分配, 图析构后随 arena 一次性释放;
+    // 拷贝出的图共享同一个 arena. 同一个 arena 不要在多个线程里同时构建图
+    BaseGraph(const std::string& name = "G",
+              bool strict = false,
+              bool directed = false,
+              const std::shared_ptr<MonotonicArena>& arena = nullptr)
+        : graph_name_(name),
+          strict_(strict),
+          directed_(directed),
+          arena_(arena),
+          statements_(ArenaAllocator<Statement>(arena.get())),
+          attrs_(ArenaAllocator<AttrPair>(arena.get())),
+          strings_(arena) {}
+
+    void set_graph_attr(std::string key, std::string value) {
+        graph_attr_.set(std::move(key), std::move(value));
+        touch();
     }
 
-    void set_node_attr(const std::string& key, const std::string& value) {
-        node_attr_[key] = value;
+    void set_node_attr(std::string key, std::string value) {
+        node_attr_.set(std::move(key), std::move(value));
+        touch();
     }
 
-    void set_edge_attr(const std::string& key, const std::string& value) {
-        edge_attr_[key] = value;
+    void set_edge_attr(std::string key, std::string value) {
+        edge_attr_.set(std::move(key), std::move(value));
+        touch();
     }
 
-    void
-    node(const std::string& name, const std::string& label = "", const std::map<std::string, std::string>& attrs = {}) {
-        auto merged = attrs;
-        if (! label.empty()) merged["label"] = label;
-        statements_.push_back(Statement::make_node(name, merged));
+    // 开启去重索引时, 重复的 node() 合并到第一次的 statement 中 (新属性覆盖旧值), 不再追加
+    void node(const std::string& name, const std::string& label = "", const AttrMap& attrs = {}) {
+        Id id = strings_.intern(name);
+        const std::string* lbl = label.empty() ? nullptr : &label;
+        if (dedup_.enabled) {
+            auto it = dedup_.nodes.find(id);
+            if (it != dedup_.nodes.end()) {
+                if (attrs.empty() && ! lbl) return; // 已存在 (显式或作为边端点), 无新属性
+                if (it->second != DedupIndex::Implicit) {
+                    merge_attrs(it->second, attrs, lbl);
+                    return;
+                }
+            }
+            dedup_.nodes[id] = static_cast<uint32_t>(statements_.size());
+        }
+
+        Statement s = Statement::make_node(id);
+        append_attrs(s, attrs, lbl);
+        push_statement(s);
     }
 
-    void edge(const std::string& tail, const std::string& head, const std::map<std::string, std::string>& attrs = {}) {
-        statements_.push_back(Statement::make_edge(tail, head, attrs));
+    // 开启去重索引的 strict 图中, 重复的边合并属性而不是再追加一条
+    void edge(const std::string& tail, const std::string& head, const AttrMap& attrs = {}) {
+        Statement s = Statement::make_edge(strings_.intern(tail), strings_.intern(head));
+        if (dedup_.enabled) {
+            dedup_.nodes.emplace(s.a, DedupIndex::Implicit);
+            dedup_.nodes.emplace(s.b, DedupIndex::Implicit);
+            uint64_t key = edge_key(s.a, s.b);
+            auto it = dedup_.edges.find(key);
+            if (strict_ && it != dedup_.edges.end()) {
+                if (! attrs.empty()) merge_attrs(it->second, attrs, nullptr);
+                return;
+            }
+            if (it == dedup_.edges.end()) dedup_.edges.emplace(key, static_cast<uint32_t>(statements_.size()));
+            ++dedup_.edge_count;
+        }
+
+        append_attrs(s, attrs, nullptr);
+        push_statement(s);
     }
 
-    void edges(const std::vector<std::pair<std::string, std::string>>& pairs,
-               const std::map<std::string, std::string>& attrs = {}) {
+    void edges(const std::vector<std::pair<std::string, std::string>>& pairs, const AttrMap& attrs = {}) {
         for (const auto& p : pairs) {
             edge(p.first, p.second, attrs);
         }
     }
 
     void subgraph(const BaseGraph& sub) {
-        statements_.push_back(Statement::make_subgraph(std::make_shared<BaseGraph>(sub)));
+        subgraphs_.push_back(std::make_shared<BaseGraph>(sub));
+        push_statement(Statement::make_subgraph(static_cast<uint32_t>(subgraphs_.size() - 1)));
+    }
+
+    // 接管 sub 的存储, 不做深拷贝
+    void subgraph(BaseGraph&& sub) {
+        subgraphs_.push_back(std::make_shared<BaseGraph>(std::move(sub)));
+        push_statement(Statement::make_subgraph(static_cast<uint32_t>(subgraphs_.size() - 1)));
+    }
+
+    // 共享所有权: 不拷贝, 之后对 sub 的修改会反映在本图的输出中
+    void subgraph(const std::shared_ptr<BaseGraph>& sub) {
+        if (! sub) throw RequiredArgumentError("subgraph (null shared_ptr)");
+        subgraphs_.push_back(sub);
+        push_statement(Statement::make_subgraph(static_cast<uint32_t>(subgraphs_.size() - 1)));
+    }
+
+    // 原地创建子图并返回其引用 (与本图共用 arena 和序列化缓存设置), 引用在本图存活期间有效.
+    // name 不必带 "cluster_" 前缀, 见 subgraph_id()
+    BaseGraph& add_subgraph(const std::string& name) {
+        std::shared_ptr<BaseGraph> sub = std::make_shared<BaseGraph>(name, strict_, directed_, arena_);
+        if (serial_cache_.enabled()) sub->enable_serialization_cache();
+        subgraph(sub);
+        return *sub;
+    }
+
+    // 预先分配 statement / 属性 / 驻留串的空间, 已知规模时避免构建过程中反复扩容
+    void reserve(size_t statements, size_t attrs = 0) {
+        statements_.reserve(statements);
+        attrs_.reserve(attrs);
+        strings_.reserve(statements + attrs);
     }
 
     void save_to(const std::string& path) const {
-        std::ofstream ofs(path.c_str());
+        std::ofstream ofs(path.c_str(), std::ios::binary);
         if (! ofs) {
             throw std::runtime_error("Failed to open file for writing: " + path);
         }
-        ofs << to_string();
+        save_to(ofs);
     }
 
     void save_to(std::ostream& os) const {
-        os << to_string();
+        DotWriter out = DotWriter::to_ostream(os);
+        write(out);
+        out.flush();
     }
 
-    std::string to_string(int indent_level = 0) const {
-        const std::string indent(indent_level * 4, ' ');
-        std::ostringstream oss;
+    // 将 DOT 文本单遍写入任意 sink (ostream / fd / 缓冲区 / 回调), 不产生中间字符串
+    void write(DotWriter& out, int indent_level = 0) const {
+        const int inner = indent_level + 1;
 
         if (! comment_.empty() && indent_level == 0) {
-            oss << "// " << comment_ << "\n";
+            out << "// " << comment_ << '\n';
         }
 
+        out.indent(indent_level);
         if (indent_level == 0) {
-            if (strict_) oss << "strict ";
-            oss << (directed_ ? "digraph " : "graph ") << escape_id(graph_name_) << " {\n";
+            if (strict_) out << "strict ";
+            out << (directed_ ? "digraph " : "graph ");
+            write_id(out, graph_name_);
         } else {
-            oss << indent << "subgraph " << escape_id("cluster_" + graph_name_) << " {\n";
+            // 匿名子图 (名字为空且不是 cluster) 输出为 "subgraph {"
+            std::string id = subgraph_id();
+            out << "subgraph";
+            if (! id.empty()) {
+                out.put(' ');
+                write_id(out, id);
+            }
         }
+        out << " {\n";
 
-        if (! graph_attr_.empty()) {
-            oss << indent << "    graph [" << format_attrs(graph_attr_) << "];\n";
+        write_default_attrs(out, inner, "graph", graph_attr_);
+        write_default_attrs(out, inner, "node", node_attr_);
+        write_default_attrs(out, inner, "edge", edge_attr_);
+
+        if (serial_cache_.enabled()) {
+            write_statements_cached(out, inner);
+        } else {
+            for (const auto& stmt : statements_) {
+                write_statement(out, stmt, inner);
+            }
         }
-        if (! node_attr_.empty()) {
-            oss << indent << "    node [" << format_attrs(node_attr_) << "];\n";
+
+        out.indent(indent_level);
+        out << "}\n";
+    }
+
+    std::string to_string(int indent_level = 0) const {
+        std::string result;
+        {
+            DotWriter out = DotWriter::to_string(result);
+            write(out, indent_level);
         }
-        if (! edge_attr_.empty()) {
-            oss << indent << "    edge [" << format_attrs(edge_attr_) << "];\n";
+        return result;
+    }
+
+    void render(const std::string& output_path, const RenderOptions& render_options_ = RenderOptions()) const {
+        // 缓存与 worker 都产出内存结果, 再写文件
+        if (render_options_.cache || render_options_.backend == RenderBackend::Worker) {
+            RenderOptions opts = render_options_;
+            Renderer::deduce_format(output_path, opts);
+            write_cached_output(output_path, render_to_memory(opts), opts);
+            return;
         }
+        if (render_options_.backend == RenderBackend::InProcess) {
+            GvcRenderer::render_graph(*this, output_path, render_options_);
+            return;
+        }
+        Renderer::render_from_producer(producer(), output_path, render_options_);
+    }
 
-        for (const auto& stmt : statements_) {
-            oss << stmt.to_string(*this, indent_level + 1);
+    std::vector<uint8_t> render_to_memory(const RenderOptions& render_options_ = RenderOptions()) const {
+        if (render_options_.cache) {
+            return render_options_.cache->get_or_render(RenderCache::make_key(producer(), render_options_),
+                                                        [&] { return render_to_memory_uncached(render_options_); });
+        }
+        return render_to_memory_uncached(render_options_);
+    }
+
+    // 渲染结果按块交给 sink (ByteSink 的派生类, 如 CallbackSink), 不在内存中攒出完整结果.
+    // 渲染失败时 sink 可能已经收到部分输出; 缓存 / 进程内 / worker 后端先得到完整结果再一次交出
+    template <typename Sink>
+    void render_to_sink(ByteSink<Sink>& sink, const RenderOptions& render_options_ = RenderOptions()) const {
+        if (render_options_.cache || render_options_.backend != RenderBackend::Subprocess) {
+            std::vector<uint8_t> data = render_to_memory(render_options_);
+            sink.append(data.data(), data.size());
+            return;
         }
+        Renderer::render_from_producer_to_sink(producer(), sink, render_options_);
+    }
 
-        oss << indent << "}\n";
-        return oss.str();
+    // fd 直接作为 engine 的 stdout (文件、管道、socket), 输出不经过本进程. fd 应为阻塞模式, 调用方负责关闭
+    void render_to_fd(int fd, const RenderOptions& render_options_ = RenderOptions()) const {
+        if (render_options_.cache || render_options_.backend != RenderBackend::Subprocess) {
+            FdSink sink(fd);
+            render_to_sink(sink, render_options_);
+            return;
+        }
+        Renderer::render_from_producer_to_fd(producer(), fd, render_options_);
     }
 
-    void render(const std::string& output_path, const RenderOptions& render_options_ = RenderOptions()) const {
-        Renderer::render_from_string(to_string(), output_path, render_options_);
+    // options.outputs 中的全部格式由一次 layout 产出; 没有 path 的输出按 format 返回.
+    // worker 后端与开启缓存时退化为逐个输出渲染
+    RenderResults render_outputs(const RenderOptions& render_options_) const {
+        if (render_options_.cache || render_options_.backend == RenderBackend::Worker) {
+            return render_outputs_each(render_options_,
+                                       [this](const RenderOptions& opts) { return render_to_memory(opts); });
+        }
+        if (render_options_.backend == RenderBackend::InProcess) {
+            return GvcRenderer::render_graph_outputs(*this, render_options_);
+        }
+        return Renderer::render_outputs_from_producer(producer(), render_options_);
     }
 
-    std::vector<uint8_t> render_to_memory(const RenderOptions& render_options_ = RenderOptions()) const {
-        return Renderer::render_from_string_to_memory(to_string(), render_options_);
+    // 只做布局: 以 -Tdot 渲染 (沿用 options 的 engine / backend / 缓存) 并解析出节点与边的坐标.
+    // 之后只改样式 (颜色、字体、tooltip ...) 时用 render(layout, ...) 重新渲染, 不再重新布局
+    Layout layout(const RenderOptions& render_options_ = RenderOptions()) const {
+        RenderOptions opts = render_options_;
+        opts.set_format("dot").set_renderer("").set_formatter("");
+        opts.outputs.clear();
+        std::vector<uint8_t> text = render_to_memory(opts);
+        return Layout::parse(reinterpret_cast<const char*>(text.data()), text.size());
+    }
+
+    // 以 layout 中的坐标渲染本图当前的样式: 换成 neato -n2, 节点和边的位置全部沿用, 跳过布局.
+    // 节点与边需与生成 layout 时一致, 增删节点后要重新 layout()
+    void render(const Layout& layout,
+                const std::string& output_path,
+                const RenderOptions& render_options_ = RenderOptions()) const {
+        with_layout(layout).render(output_path, positioned_options(render_options_));
+    }
+
+    std::vector<uint8_t> render_to_memory(const Layout& layout,
+                                          const RenderOptions& render_options_ = RenderOptions()) const {
+        return with_layout(layout).render_to_memory(positioned_options(render_options_));
+    }
+
+    RenderResults render_outputs(const Layout& layout, const RenderOptions& render_options_) const {
+        return with_layout(layout).render_outputs(positioned_options(render_options_));
+    }
+
+    // 本图的副本: 每条边带上 layout 中对应的坐标, 根图末尾追加带坐标的节点 statement
+    BaseGraph with_layout(const Layout& layout) const {
+        BaseGraph g(*this);
+        std::map<std::pair<std::string, std::string>, size_t> seen;
+        g.apply_layout(layout, seen);
+        for (const auto& kv : layout.graph_attrs()) g.graph_attr_.set(kv.first, kv.second);
+        for (const auto& node : layout.nodes()) {
+            if (node.second.empty()) continue;
+            Statement stmt = Statement::make_node(g.strings_.intern(node.first));
+            g.append_attrs(stmt, node.second, nullptr);
+            g.push_statement(stmt);
+        }
+        return g;
+    }
+
+    // 后台渲染到内存. 调用时先对图 (含子图) 做一次深拷贝快照, 之后修改或销毁本图不影响正在进行的渲染
+    RenderHandle render_async(const RenderOptions& render_options_ = RenderOptions(),
+                              RenderHandle::Callback callback = RenderHandle::Callback()) const {
+        std::shared_ptr<BaseGraph> snapshot = clone();
+        return RenderHandle::launch(
+            [snapshot](const RenderOptions& opts) { return snapshot->render_to_memory(opts); },
+            render_options_,
+            callback);
+    }
+
+    // 后台渲染到文件, 完成后 get() 返回空 vector
+    RenderHandle render_async(const std::string& output_path,
+                              const RenderOptions& render_options_ = RenderOptions(),
+                              RenderHandle::Callback callback = RenderHandle::Callback()) const {
+        std::shared_ptr<BaseGraph> snapshot = clone();
+        return RenderHandle::launch(
+            [snapshot, output_path](const RenderOptions& opts) {
+                snapshot->render(output_path, opts);
+                return std::vector<uint8_t>();
+            },
+            render_options_,
+            callback);
     }
 
     void view(const RenderOptions& render_options_ = RenderOptions()) const {
         std::string output_path = TmpFile::generate_path(DefaultFormat);
-        Renderer::render_from_string(to_string(), output_path, render_options_);
+        render(output_path, render_options_);
         Viewer::view(output_path);
     }
 
     void set_comment(const std::string& comment) {
         comment_ = comment;
+        touch();
+    }
+
+    // 开启节点/边去重索引 (见 node() / edge()), 并为已有 statements 建立索引; 已存在的重复项不会被合并.
+    // 索引只覆盖本图自身的 statements, 不含子图
+    void enable_dedup(bool on = true) {
+        dedup_ = DedupIndex();
+        dedup_.enabled = on;
+        if (! on) return;
+        for (size_t i = 0; i < statements_.size(); ++i) {
+            const Statement& stmt = statements_[i];
+            if (stmt.type == Statement::Type::Node) {
+                auto r = dedup_.nodes.emplace(stmt.a, static_cast<uint32_t>(i));
+                if (! r.second && r.first->second == DedupIndex::Implicit) r.first->second = static_cast<uint32_t>(i);
+            } else if (stmt.type == Statement::Type::Edge) {
+                dedup_.nodes.emplace(stmt.a, DedupIndex::Implicit);
+                dedup_.nodes.emplace(stmt.b, DedupIndex::Implicit);
+                dedup_.edges.emplace(edge_key(stmt.a, stmt.b), static_cast<uint32_t>(i));
+                ++dedup_.edge_count;
+            }
+        }
+    }
+
+    bool dedup_enabled() const {
+        return dedup_.enabled;
+    }
+
+    // 以下查询只看本图自身的 statements (不含子图); 开启去重索引时为 O(1), 否则线性扫描.
+    // 只作为边端点出现的名字也算节点, 与 DOT 语义一致
+    bool has_node(const std::string& name) const {
+        if (dedup_.enabled) {
+            Id id;
+            return strings_.find(name, id) && dedup_.nodes.count(id) != 0;
+        }
+        StrRef ref{name.data(), name.size()};
+        for (const auto& stmt : statements_) {
+            if (stmt.type == Statement::Type::Node && strings_.str(stmt.a) == ref) return true;
+            if (stmt.type == Statement::Type::Edge && (strings_.str(stmt.a) == ref || strings_.str(stmt.b) == ref)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 无向图中 (a, b) 与 (b, a) 视为同一条边
+    bool has_edge(const std::string& tail, const std::string& head) const {
+        Id t, h;
+        if (! strings_.find(tail, t) || ! strings_.find(head, h)) return false;
+        if (dedup_.enabled) return dedup_.edges.count(edge_key(t, h)) != 0;
+        uint64_t key = edge_key(t, h);
+        for (const auto& stmt : statements_) {
+            if (stmt.type == Statement::Type::Edge && edge_key(stmt.a, stmt.b) == key) return true;
+        }
+        return false;
+    }
+
+    size_t node_count() const {
+        if (dedup_.enabled) return dedup_.nodes.size();
+        std::unordered_set<Id> ids;
+        for (const auto& stmt : statements_) {
+            if (stmt.type == Statement::Type::Node) ids.insert(stmt.a);
+            if (stmt.type == Statement::Type::Edge) {
+                ids.insert(stmt.a);
+                ids.insert(stmt.b);
+            }
+        }
+        return ids.size();
+    }
+
+    // 边 statement 的条数 (strict 图开启去重后即不同边的条数)
+    size_t edge_count() const {
+        if (dedup_.enabled) return dedup_.edge_count;
+        size_t n = 0;
+        for (const auto& stmt : statements_) {
+            if (stmt.type == Statement::Type::Edge) ++n;
+        }
+        return n;
+    }
+
+    // 开启后 statements 按块缓存序列化结果, 反复 to_string() / render() 只重新生成改动过的块.
+    // 同时作用于当前已添加的子图. 适合大图上少量增量修改的场景, 代价是额外保存一份 DOT 文本
+    void enable_serialization_cache(bool on = true) {
+        serial_cache_.set_enabled(on);
+        for (const auto& sg : subgraphs_) sg->enable_serialization_cache(on);
+    }
+
+    bool serialization_cache_enabled() const {
+        return serial_cache_.enabled();
+    }
+
+    // 本图的修改版本号, 每次修改后变化 (不含子图)
+    uint64_t version() const {
+        return version_;
+    }
+
+    // 包含所有子图在内的最新版本号
+    uint64_t deep_version() const {
+        uint64_t v = version_;
+        for (const auto& sg : subgraphs_) {
+            uint64_t sv = sg->deep_version();
+            if (sv > v) v = sv;
+        }
+        return v;
+    }
+
+    const std::string& name() const {
+        return graph_name_;
+    }
+
+    bool is_directed() const {
+        return directed_;
+    }
+
+    bool is_strict() const {
+        return strict_;
+    }
+
+    const AttrMap& graph_attr() const {
+        return graph_attr_;
+    }
+
+    const AttrMap& node_attr() const {
+        return node_attr_;
+    }
+
+    const AttrMap& edge_attr() const {
+        return edge_attr_;
+    }
+
+    // 作为子图输出时使用的 ID. 名字已以 "cluster" 开头或关闭了 cluster 时不加前缀
+    std::string subgraph_id() const {
+        if (! cluster_ || graph_name_.compare(0, 7, "cluster") == 0) return graph_name_;
+        return "cluster_" + graph_name_;
+    }
+
+    // 关闭后作为普通子图输出 (名字原样使用, 为空时是匿名子图); 解析得到的子图都是关闭的
+    void set_cluster(bool on) {
+        cluster_ = on;
+        touch();
+    }
+
+    bool is_cluster() const {
+        return cluster_;
+    }
+
+    bool has_raw_lines() const {
+        for (const auto& stmt : statements_) {
+            if (stmt.type == Statement::Type::RawLine) return true;
+        }
+        return false;
+    }
+
+    // 按插入顺序遍历 statements, 供不经过 DOT 文本的后端使用.
+    // Visitor 需要提供 raw(line), node(name, attrs), edge(tail, head, attrs), subgraph(const BaseGraph&);
+    // attrs 为 AttrView
+    template <typename Visitor>
+    void visit(Visitor& v) const {
+        for (const auto& stmt : statements_) {
+            switch (stmt.type) {
+                case Statement::Type::RawLine:
+                    v.raw(strings_.str(stmt.a));
+                    break;
+                case Statement::Type::Node:
+                    v.node(strings_.str(stmt.a), attrs_of(stmt));
+                    break;
+                case Statement::Type::Edge:
+                    v.edge(strings_.str(stmt.a), strings_.str(stmt.b), attrs_of(stmt));
+                    break;
+                case Statement::Type::Subgraph:
+                    v.subgraph(*subgraphs_[stmt.a]);
+                    break;
+            }
+        }
     }
 
   private:
-    static inline std::string escape_id(const std::string& id) {
-        // 允许字母、数字、下划线，不加引号
-        if (id.empty()) return "\"\"";
+    std::vector<uint8_t> render_to_memory_uncached(const RenderOptions& render_options_) const {
+        if (render_options_.backend == RenderBackend::InProcess) {
+            return GvcRenderer::render_graph(*this, render_options_);
+        }
+        if (render_options_.backend == RenderBackend::Worker) {
+            return worker_pool_of(render_options_).render(to_string(), render_options_);
+        }
+        return Renderer::render_from_producer_to_memory(producer(), render_options_);
+    }
+
+    // 深拷贝: 子图也逐层复制, 不再与调用方持有的子图句柄 (add_subgraph / shared_ptr) 共享
+    std::shared_ptr<BaseGraph> clone() const {
+        std::shared_ptr<BaseGraph> g = std::make_shared<BaseGraph>(*this);
+        for (auto& sub : g->subgraphs_) sub = sub->clone();
+        return g;
+    }
+
+    static RenderOptions positioned_options(const RenderOptions& render_options_) {
+        RenderOptions opts = render_options_;
+        opts.set_engine(Layout::neato_engine(render_options_.engine)).set_neato_no_op(true, 2);
+        return opts;
+    }
+
+    // 给每条边合并 layout 中的坐标, 子图带上自己的 bb / lp; 子图先复制一份, 不影响共享它的其他图.
+    // 同一对节点之间的多重边按在整棵树中出现的顺序对应
+    void apply_layout(const Layout& layout, std::map<std::pair<std::string, std::string>, size_t>& seen) {
+        dedup_ = DedupIndex();
+        for (size_t i = 0; i < statements_.size(); ++i) {
+            const Statement& stmt = statements_[i];
+            if (stmt.type == Statement::Type::Subgraph) {
+                std::shared_ptr<BaseGraph> sub = std::make_shared<BaseGraph>(*subgraphs_[stmt.a]);
+                if (const AttrMap* attrs = layout.subgraph_attrs(sub->subgraph_id())) {
+                    for (const auto& kv : *attrs) sub->graph_attr_.set(kv.first, kv.second);
+                }
+                sub->apply_layout(layout, seen);
+                subgraphs_[stmt.a] = sub;
+            } else if (stmt.type == Statement::Type::Edge) {
+                std::string tail = strings_.str(stmt.a).str();
+                std::string head = strings_.str(stmt.b).str();
+                if (! directed_ && head < tail) std::swap(tail, head);
+                const AttrMap* attrs = layout.edge_attrs(tail, head, seen[std::make_pair(tail, head)]++);
+                if (attrs && ! attrs->empty()) merge_attrs(static_cast<uint32_t>(i), *attrs, nullptr);
+            }
+        }
+    }
+
+    DotProducer producer() const {
+        return [this](DotWriter& out) { write(out); };
+    }
+
+    void touch() {
+        version_ = next_graph_version();
+    }
+
+    void push_statement(const Statement& stmt) {
+        statements_.push_back(stmt);
+        touch();
+        serial_cache_.invalidate(statements_.size() - 1);
+    }
+
+    // 逐块输出, 只重新生成失效或所含子图有变化的块
+    void write_statements_cached(DotWriter& out, int indent_level) const {
+        std::lock_guard<std::mutex> lock(serial_cache_.mutex());
+        size_t n_chunks = (statements_.size() + SerializationChunkSize - 1) / SerializationChunkSize;
+        std::vector<SerializationCache::Chunk>& chunks = serial_cache_.chunks(n_chunks, indent_level);
+
+        for (size_t c = 0; c < n_chunks; ++c) {
+            SerializationCache::Chunk& chunk = chunks[c];
+            uint64_t sub_version = 0;
+            if (chunk.valid) {
+                for (uint32_t idx : chunk.subgraphs) {
+                    uint64_t v = subgraphs_[idx]->deep_version();
+                    if (v > sub_version) sub_version = v;
+                }
+            }
+
+            if (! chunk.valid || sub_version != chunk.subgraph_version) {
+                size_t begin = c * SerializationChunkSize;
+                size_t end = std::min(begin + SerializationChunkSize, statements_.size());
+                chunk.text.clear();
+                chunk.subgraphs.clear();
+                sub_version = 0;
+                {
+                    DotWriter w = DotWriter::to_string(chunk.text);
+                    for (size_t i = begin; i < end; ++i) {
+                        const Statement& stmt = statements_[i];
+                        if (stmt.type == Statement::Type::Subgraph) {
+                            chunk.subgraphs.push_back(stmt.a);
+                            uint64_t v = subgraphs_[stmt.a]->deep_version();
+                            if (v > sub_version) sub_version = v;
+                        }
+                        write_statement(w, stmt, indent_level);
+                    }
+                }
+                chunk.subgraph_version = sub_version;
+                chunk.valid = true;
+            }
+            out.write(chunk.text);
+        }
+    }
+
+    AttrView attrs_of(const Statement& stmt) const {
+        return AttrView(attrs_.data() + stmt.attr_begin, stmt.attr_count, &strings_);
+    }
+
+    // 解析器使用: attrs 为已驻留的 (key, value), 按 key 排序, 同名 key 保留最后一个, 然后追加到 attrs_
+    void append_attr_ids(Statement& stmt, std::vector<AttrPair>& attrs) {
+        if (attrs.empty()) return;
+        sort_attr_ids(attrs);
+        size_t begin = attrs_.size();
+        for (size_t i = 0; i < attrs.size(); ++i) {
+            if (i + 1 < attrs.size() && attrs[i + 1].key == attrs[i].key) continue;
+            attrs_.push_back(attrs[i]);
+        }
+        size_t count = attrs_.size() - begin;
+        if (count > 0xffff) throw std::length_error("too many attributes on one statement");
+        stmt.attr_begin = static_cast<uint32_t>(begin);
+        stmt.attr_count = static_cast<uint16_t>(count);
+    }
+
+    // 按 key 的字节序稳定排序, 同名 key 的先后不变
+    void sort_attr_ids(std::vector<AttrPair>& attrs) const {
+        std::stable_sort(attrs.begin(), attrs.end(), [this](const AttrPair& a, const AttrPair& b) {
+            StrRef x = strings_.str(a.key), y = strings_.str(b.key);
+            int c = std::memcmp(x.data, y.data, std::min(x.size, y.size));
+            return c < 0 || (c == 0 && x.size < y.size);
+        });
+    }
+
+    // 把 attrs (按 key 有序) 驻留后追加到 attrs_; label 非空时覆盖或插入 "label", 保持有序
+    void append_attrs(Statement& stmt, const AttrMap& attrs, const std::string* label) {
+        size_t count = attrs.size() + (label ? 1 : 0);
+        if (count == 0) return;
+        if (count > 0xffff) throw std::length_error("too many attributes on one statement");
 
-        for (char ch : id) {
-            if (! std::isalnum(static_cast<unsigned char>(ch)) && ch != '_') {
-                goto need_escape;
+        stmt.attr_begin = static_cast<uint32_t>(attrs_.size());
+        static const std::string label_key = "label";
+        bool label_done = label == nullptr;
+        for (const auto& kv : attrs) {
+            if (! label_done && kv.first >= label_key) {
+                attrs_.push_back(AttrPair{strings_.intern(label_key), strings_.intern(*label)});
+                label_done = true;
+                if (kv.first == label_key) continue;
             }
+            attrs_.push_back(AttrPair{strings_.intern(kv.first), strings_.intern(kv.second)});
+        }
+        if (! label_done) {
+            attrs_.push_back(AttrPair{strings_.intern(label_key), strings_.intern(*label)});
         }
-        return id;
+        stmt.attr_count = static_cast<uint16_t>(attrs_.size() - stmt.attr_begin);
+    }
+
+    // 无向图的键与端点顺序无关
+    uint64_t edge_key(Id tail, Id head) const {
+        if (! directed_ && head < tail) std::swap(tail, head);
+        return (static_cast<uint64_t>(tail) << 32) | head;
+    }
 
-    need_escape:
-        std::ostringstream oss;
-        oss << "\"";
-        for (char ch : id) {
-            if (ch == '"')
-                oss << "\\\"";
-            else
-                oss << ch;
+    // 把新属性合并进已有 statement. 合并结果不比旧区间长 (只改了值) 时原地改写; 旧区间在 attrs_ 末尾时就地延长;
+    // 否则追加到末尾, 旧区间废弃
+    void merge_attrs(uint32_t index, const AttrMap& attrs, const std::string* label) {
+        Statement& stmt = statements_[index];
+        auto old_begin = attrs_.begin() + stmt.attr_begin;
+        std::vector<AttrPair> merged(old_begin, old_begin + stmt.attr_count);
+        for (const auto& kv : attrs) merged.push_back(AttrPair{strings_.intern(kv.first), strings_.intern(kv.second)});
+        if (label) merged.push_back(AttrPair{strings_.intern("label", 5), strings_.intern(*label)});
+        sort_attr_ids(merged);
+        size_t n = 0;
+        for (size_t i = 0; i < merged.size(); ++i) {
+            if (i + 1 < merged.size() && merged[i + 1].key == merged[i].key) continue; // 同名 key 保留最后一个
+            merged[n++] = merged[i];
         }
-        oss << "\"";
-        return oss.str();
+        merged.resize(n);
+        if (n > 0xffff) throw std::length_error("too many attributes on one statement");
+
+        if (n <= stmt.attr_count) {
+            std::copy(merged.begin(), merged.end(), old_begin);
+        } else {
+            bool at_tail = stmt.attr_count != 0 && stmt.attr_begin + stmt.attr_count == attrs_.size();
+            if (! at_tail) stmt.attr_begin = static_cast<uint32_t>(attrs_.size());
+            attrs_.resize(stmt.attr_begin);
+            attrs_.insert(attrs_.end(), merged.begin(), merged.end());
+        }
+        stmt.attr_count = static_cast<uint16_t>(n);
+        touch();
+        serial_cache_.invalidate(index);
+    }
+
+    void write_statement(DotWriter& out, const Statement& stmt, int indent_level) const {
+        switch (stmt.type) {
+            case Statement::Type::RawLine:
+                out.indent(indent_level);
+            {
+                StrRef line = strings_.str(stmt.a);
+                out.write(line.data, line.size);
+                out.put('\n');
+            }
+                break;
+
+            case Statement::Type::Node:
+                out.indent(indent_level);
+                write_id(out, strings_.str(stmt.a));
+                if (stmt.attr_count != 0) {
+                    out << " [";
+                    write_attrs(out, attrs_of(stmt));
+                    out << ']';
+                }
+                out << ";\n";
+                break;
+
+            case Statement::Type::Edge:
+                out.indent(indent_level);
+                write_id(out, strings_.str(stmt.a));
+                out << ' ' << edge_op() << ' ';
+                write_id(out, strings_.str(stmt.b));
+                if (stmt.attr_count != 0) {
+                    out << " [";
+                    write_attrs(out, attrs_of(stmt));
+                    out << ']';
+                }
+                out << ";\n";
+                break;
+
+            case Statement::Type::Subgraph:
+                subgraphs_[stmt.a]->write(out, indent_level); // recursive
+                break;
+        }
+    }
+
+    static void write_default_attrs(DotWriter& out, int indent_level, const char* kind, const AttrMap& attrs) {
+        if (attrs.empty()) return;
+        out.indent(indent_level);
+        out << kind << " [";
+        write_attrs(out, attrs);
+        out << "];\n";
+    }
+
+    static inline void write_id(DotWriter& out, const std::string& id) {
+        write_id(out, StrRef{id.data(), id.size()});
+    }
+
+    static inline void write_id(DotWriter& out, StrRef id) {
+        IdEscaper::write_id(out, id.data, id.size);
     }
 
-    static inline std::string format_attrs(const AttrMap& attrs) {
-        std::ostringstream oss;
+    template <typename Attrs>
+    static inline void write_attrs(DotWriter& out, const Attrs& attrs) {
         bool first = true;
         for (const auto& kv : attrs) {
-            if (! first) oss << ", ";
+            if (! first) out << ", ";
             first = false;
-            oss << escape_id(kv.first) << "=" << escape_id(kv.second);
+            write_id(out, kv.first);
+            out.put('=');
+            write_id(out, kv.second);
         }
-        return oss.str();
     }
 };
 
 class Graph : public BaseGraph {
   public:
-    Graph(const std::string& name = "G", bool strict = false) : BaseGraph(name, strict, false) {}
+    Graph(const std::string& name = "G",
+          bool strict = false,
+          const std::shared_ptr<MonotonicArena>& arena = nullptr)
+        : BaseGraph(name, strict, false, arena) {}
 };
 
 class DiGraph : public BaseGraph {
   public:
-    DiGraph(const std::string& name = "DG", bool strict = false) : BaseGraph(name, strict, true) {}
+    DiGraph(const std::string& name = "DG",
+            bool strict = false,
+            const std::shared_ptr<MonotonicArena>& arena = nullptr)
+        : BaseGraph(name, strict, true, arena) {}
 };
 
 } // namespace kgraphviz
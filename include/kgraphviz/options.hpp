@@ -1,8 +1,14 @@
 #pragma once
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace kgraphviz {
 
+class RenderCache;
+class CancelToken;
+class WorkerPool;
+
 const static std::string DefaultFormat = "svg";
 
 #ifdef _WIN32
@@ -11,6 +17,22 @@ const static std::string DefaultEngine = "dot.exe";
 const static std::string DefaultEngine = "dot";
 #endif
 
+// Subprocess: 启动 engine 可执行文件 (默认)
+// InProcess:  直接调用 libgvc/libcgraph, 需要定义 KGRAPHVIZ_WITH_GVC 并链接 -lgvc -lcgraph
+// Worker:     交给 RenderOptions::worker_pool 中的常驻 worker 进程
+enum class RenderBackend {
+    Subprocess,
+    InProcess,
+    Worker
+};
+
+// render_outputs() 的一个输出. format 可以写成 "png:cairo" 的形式, 为空时从 path 的扩展名推断;
+// path 为空时结果留在内存中, 按 format 返回
+struct RenderOutput {
+    std::string format;
+    std::string path;
+};
+
 struct RenderOptions {
     std::string engine = DefaultEngine; // layout engine, default "dot"
     std::string format = "";            // 默认可以从 output filename 中推断出来
@@ -20,10 +42,28 @@ struct RenderOptions {
     std::string formatter; // e.g., "gd"
 
     bool neato_no_op = false;
+    int neato_no_op_level = 1; // 1: -n, 只用节点 pos; 2: -n2, 边也沿用已有的 pos
     bool quiet = false;
     bool raise_if_result_exists = false;
     bool overwrite_filepath = false;
 
+    RenderBackend backend = RenderBackend::Subprocess;
+
+    // 非空时 BaseGraph / Source 的渲染先查缓存, 命中则不启动任何进程
+    std::shared_ptr<RenderCache> cache;
+
+    // 子进程后端的墙钟超时 (毫秒), 0 表示不限; 超时后 engine 被杀掉并抛出 TimeoutExpired
+    long timeout_ms = 0;
+
+    // 非空时可以从其他线程调用 cancel_token->cancel() 终止渲染, 抛出 RenderCancelled
+    std::shared_ptr<CancelToken> cancel_token;
+
+    // RenderBackend::Worker 使用的 worker 池
+    std::shared_ptr<WorkerPool> worker_pool;
+
+    // render_outputs() 一次 layout 产出的全部结果; render() / render_to_memory() 不使用
+    std::vector<RenderOutput> outputs;
+
     RenderOptions& set_engine(const std::string& eng) {
         engine = eng;
         return *this;
@@ -44,11 +84,18 @@ struct RenderOptions {
         return *this;
     }
 
-    RenderOptions& set_neato_no_op(bool flag) {
+    RenderOptions& set_neato_no_op(bool flag, int level = 1) {
         neato_no_op = flag;
+        neato_no_op_level = level;
         return *this;
     }
 
+    // engine 的命令行参数 "-n" / "-n2"; 未开启时为空
+    std::string neato_no_op_arg() const {
+        if (! neato_no_op) return "";
+        return neato_no_op_level > 1 ? "-n2" : "-n";
+    }
+
     RenderOptions& set_quiet(bool flag) {
         quiet = flag;
         return *this;
@@ -63,6 +110,38 @@ struct RenderOptions {
         overwrite_filepath = flag;
         return *this;
     }
+
+    RenderOptions& set_backend(RenderBackend b) {
+        backend = b;
+        return *this;
+    }
+
+    RenderOptions& set_cache(const std::shared_ptr<RenderCache>& c) {
+        cache = c;
+        return *this;
+    }
+
+    RenderOptions& set_timeout_ms(long ms) {
+        timeout_ms = ms;
+        return *this;
+    }
+
+    RenderOptions& set_cancel_token(const std::shared_ptr<CancelToken>& token) {
+        cancel_token = token;
+        return *this;
+    }
+
+    // 同时把 backend 切换为 RenderBackend::Worker
+    RenderOptions& set_worker_pool(const std::shared_ptr<WorkerPool>& pool) {
+        worker_pool = pool;
+        backend = RenderBackend::Worker;
+        return *this;
+    }
+
+    RenderOptions& add_output(const std::string& fmt, const std::string& path = "") {
+        outputs.push_back(RenderOutput{fmt, path});
+        return *this;
+    }
 };
 
 struct SourceOptions {
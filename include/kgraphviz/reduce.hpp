@@ -0,0 +1,505 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "graph.hpp"
+
+namespace kgraphviz {
+
+// 布局前的降级 (level-of-detail) 选项. 各步骤按字段顺序执行, 前一步的结果是后一步的输入
+struct ReduceOptions {
+    std::vector<std::string> roots; // max_depth 的起点, 也不会被 fold_leaves 合并
+    int max_depth = -1;             // >= 0 时只保留从 roots 出发 (有向图沿边的方向) 距离不超过它的节点
+    bool collapse_scc = false;      // 有向图: 每个强连通分量合并为一个节点
+    bool transitive_reduction = false; // 有向图: 删除能由其他路径推出的边, 需无环 (或同时 collapse_scc)
+    size_t fold_leaves = 0;            // > 0 时, 同一方向上至少这么多 (且至少 2 个) 度为 1 的叶子合并为一个汇总节点
+
+    ReduceOptions& set_max_depth(const std::vector<std::string>& from, int depth) {
+        roots = from;
+        max_depth = depth;
+        return *this;
+    }
+
+    ReduceOptions& set_collapse_scc(bool on = true) {
+        collapse_scc = on;
+        return *this;
+    }
+
+    ReduceOptions& set_transitive_reduction(bool on = true) {
+        transitive_reduction = on;
+        return *this;
+    }
+
+    ReduceOptions& set_fold_leaves(size_t min_leaves) {
+        fold_leaves = min_leaves;
+        return *this;
+    }
+};
+
+// reduce() 的结果: 降级后的图, 以及原节点与降级后节点之间的对应关系
+class Reduction {
+  public:
+    const BaseGraph& graph() const {
+        return graph_;
+    }
+
+    BaseGraph& graph() {
+        return graph_;
+    }
+
+    // 原节点在降级图中的名字; 被 max_depth 剪掉或不存在的节点返回 nullptr
+    const std::string* representative(const std::string& original) const {
+        auto it = representative_.find(original);
+        return it == representative_.end() ? nullptr : &it->second;
+    }
+
+    // 降级图中一个节点代表的全部原节点, 按在原图中首次出现的顺序
+    const std::vector<std::string>* members(const std::string& reduced) const {
+        auto it = members_.find(reduced);
+        return it == members_.end() ? nullptr : &it->second;
+    }
+
+    size_t original_node_count() const {
+        return original_nodes_;
+    }
+
+    size_t original_edge_count() const {
+        return original_edges_;
+    }
+
+  private:
+    friend class GraphReducer;
+
+    explicit Reduction(BaseGraph g) : graph_(std::move(g)) {}
+
+    BaseGraph graph_;
+    std::unordered_map<std::string, std::string> representative_;
+    std::unordered_map<std::string, std::vector<std::string>> members_;
+    size_t original_nodes_ = 0;
+    size_t original_edges_ = 0;
+};
+
+// 把整棵图 (含子图) 展开成节点和边的列表后逐步合并. 输出为不含子图的平面图:
+// 原样文本行和 cluster 结构不保留, 同一对节点之间的多条边只保留第一条 (及其属性)
+class GraphReducer {
+  public:
+    static Reduction run(const BaseGraph& g, const ReduceOptions& options) {
+        GraphReducer r(g.is_directed());
+        Flattener flat{r};
+        g.visit(flat);
+        r.original_nodes_ = r.nodes_.size();
+        r.original_edges_ = r.edges_.size();
+        r.dedup_edges();
+
+        if (options.max_depth >= 0) r.cap_depth(options.roots, options.max_depth);
+        if (options.collapse_scc && r.directed_) r.collapse_scc();
+        if (options.transitive_reduction && r.directed_) r.transitive_reduction();
+        if (options.fold_leaves > 0) r.fold_leaves(options.roots, std::max<size_t>(options.fold_leaves, 2));
+        return r.build(g);
+    }
+
+  private:
+    struct Node {
+        std::string name;
+        AttrMap attrs;
+        std::vector<uint32_t> members; // 原节点下标
+    };
+
+    struct Edge {
+        uint32_t tail;
+        uint32_t head;
+        uint32_t attrs; // edge_attrs_ 下标
+    };
+
+    // BaseGraph::visit 的 Visitor: 按出现顺序登记节点, 重复的 node statement 合并属性
+    struct Flattener {
+        GraphReducer& r;
+
+        void raw(StrRef) {}
+
+        void node(StrRef name, const BaseGraph::AttrView& attrs) {
+            AttrMap& m = r.nodes_[r.intern(name)].attrs;
+            for (const auto& kv : attrs) m.set(kv.first.str(), kv.second.str());
+        }
+
+        void edge(StrRef tail, StrRef head, const BaseGraph::AttrView& attrs) {
+            AttrMap m;
+            m.reserve(attrs.size());
+            for (const auto& kv : attrs) m.set(kv.first.str(), kv.second.str());
+            uint32_t t = r.intern(tail);
+            uint32_t h = r.intern(head);
+            r.edges_.push_back(Edge{t, h, static_cast<uint32_t>(r.edge_attrs_.size())});
+            r.edge_attrs_.push_back(std::move(m));
+        }
+
+        void subgraph(const BaseGraph& sub) {
+            sub.visit(*this);
+        }
+    };
+
+    bool directed_;
+    std::vector<Node> nodes_;
+    std::vector<Edge> edges_;
+    std::vector<AttrMap> edge_attrs_;
+    std::vector<std::string> original_names_;
+    std::unordered_map<std::string, uint32_t> index_; // 原节点名 -> 下标
+    size_t original_nodes_ = 0;
+    size_t original_edges_ = 0;
+
+    explicit GraphReducer(bool directed) : directed_(directed) {}
+
+    uint32_t intern(StrRef name) {
+        std::string s = name.str();
+        auto it = index_.find(s);
+        if (it != index_.end()) return it->second;
+        uint32_t i = static_cast<uint32_t>(nodes_.size());
+        index_.emplace(s, i);
+        original_names_.push_back(s);
+        Node n;
+        n.name = s;
+        n.members.push_back(i);
+        nodes_.push_back(std::move(n));
+        return i;
+    }
+
+    uint64_t pair_key(uint32_t t, uint32_t h) const {
+        if (! directed_ && h < t) std::swap(t, h);
+        return (static_cast<uint64_t>(t) << 32) | h;
+    }
+
+    void dedup_edges() {
+        std::unordered_set<uint64_t> seen;
+        std::vector<Edge> kept;
+        kept.reserve(edges_.size());
+        for (const Edge& e : edges_) {
+            if (seen.insert(pair_key(e.tail, e.head)).second) kept.push_back(e);
+        }
+        edges_.swap(kept);
+    }
+
+    // 按 to (旧下标 -> 新下标, -1 表示删除) 换成新的节点集合.
+    // 合并产生的自环和重复边去掉, 原有的自环保留
+    void contract(const std::vector<int64_t>& to, std::vector<Node> next) {
+        std::vector<Edge> edges;
+        edges.reserve(edges_.size());
+        std::unordered_set<uint64_t> seen;
+        for (const Edge& e : edges_) {
+            if (to[e.tail] < 0 || to[e.head] < 0) continue;
+            uint32_t t = static_cast<uint32_t>(to[e.tail]);
+            uint32_t h = static_cast<uint32_t>(to[e.head]);
+            if (t == h && e.tail != e.head) continue;
+            if (seen.insert(pair_key(t, h)).second) edges.push_back(Edge{t, h, e.attrs});
+        }
+        nodes_.swap(next);
+        edges_.swap(edges);
+    }
+
+    // adj[v]: 有向图为出边终点, 无向图为全部邻居
+    std::vector<std::vector<uint32_t>> adjacency(bool both_ways) const {
+        std::vector<std::vector<uint32_t>> adj(nodes_.size());
+        for (const Edge& e : edges_) {
+            adj[e.tail].push_back(e.head);
+            if (both_ways && e.tail != e.head) adj[e.head].push_back(e.tail);
+        }
+        return adj;
+    }
+
+    void cap_depth(const std::vector<std::string>& roots, int max_depth) {
+        if (roots.empty()) throw RequiredArgumentError("roots (required by max_depth)");
+        std::vector<std::vector<uint32_t>> adj = adjacency(! directed_);
+        std::vector<int> dist(nodes_.size(), -1);
+        std::deque<uint32_t> queue;
+        for (const auto& name : roots) {
+            auto it = index_.find(name);
+            if (it == index_.end() || dist[it->second] == 0) continue;
+            // cap_depth 总是第一步, 此时的下标就是原节点下标
+            dist[it->second] = 0;
+            queue.push_back(it->second);
+        }
+        while (! queue.empty()) {
+            uint32_t v = queue.front();
+            queue.pop_front();
+            if (dist[v] == max_depth) continue;
+            for (uint32_t w : adj[v]) {
+                if (dist[w] >= 0) continue;
+                dist[w] = dist[v] + 1;
+                queue.push_back(w);
+            }
+        }
+
+        std::vector<int64_t> to(nodes_.size(), -1);
+        std::vector<Node> next;
+        for (size_t v = 0; v < nodes_.size(); ++v) {
+            if (dist[v] < 0) continue;
+            to[v] = static_cast<int64_t>(next.size());
+            next.push_back(std::move(nodes_[v]));
+        }
+        contract(to, std::move(next));
+    }
+
+    // 迭代版 Tarjan, 返回每个节点所属分量的编号 (分量按其最小成员下标排序)
+    std::vector<uint32_t> scc(size_t& count) const {
+        const uint32_t n = static_cast<uint32_t>(nodes_.size());
+        const uint32_t none = 0xffffffffu;
+        std::vector<std::vector<uint32_t>> adj = adjacency(false);
+        std::vector<uint32_t> order(n, none), low(n, 0), comp(n, none), stack, next_child(n, 0);
+        std::vector<bool> on_stack(n, false);
+        std::vector<uint32_t> call;
+        uint32_t counter = 0, n_comp = 0;
+
+        for (uint32_t root = 0; root < n; ++root) {
+            if (order[root] != none) continue;
+            call.push_back(root);
+            while (! call.empty()) {
+                uint32_t v = call.back();
+                if (order[v] == none) {
+                    order[v] = low[v] = counter++;
+                    stack.push_back(v);
+                    on_stack[v] = true;
+                }
+                if (next_child[v] < adj[v].size()) {
+                    uint32_t w = adj[v][next_child[v]++];
+                    if (order[w] == none) {
+                        call.push_back(w);
+                    } else if (on_stack[w]) {
+                        low[v] = std::min(low[v], order[w]);
+                    }
+                    continue;
+                }
+                call.pop_back();
+                if (! call.empty()) low[call.back()] = std::min(low[call.back()], low[v]);
+                if (low[v] == order[v]) {
+                    uint32_t w;
+                    do {
+                        w = stack.back();
+                        stack.pop_back();
+                        on_stack[w] = false;
+                        comp[w] = n_comp;
+                    } while (w != v);
+                    ++n_comp;
+                }
+            }
+        }
+
+        // 重新编号, 让输出顺序跟随原图中的出现顺序
+        std::vector<uint32_t> renumber(n_comp, none);
+        uint32_t next = 0;
+        for (uint32_t v = 0; v < n; ++v) {
+            if (renumber[comp[v]] == none) renumber[comp[v]] = next++;
+            comp[v] = renumber[comp[v]];
+        }
+        count = n_comp;
+        return comp;
+    }
+
+    void collapse_scc() {
+        size_t count = 0;
+        std::vector<uint32_t> comp = scc(count);
+        if (count == nodes_.size()) return;
+
+        std::vector<int64_t> to(nodes_.size());
+        std::vector<Node> next(count);
+        std::vector<size_t> sizes(count, 0);
+        for (size_t v = 0; v < nodes_.size(); ++v) {
+            to[v] = comp[v];
+            ++sizes[comp[v]];
+        }
+        for (size_t v = 0; v < nodes_.size(); ++v) {
+            Node& dst = next[comp[v]];
+            if (dst.members.empty()) {
+                // 第一个成员的名字和样式作为整个分量的代表
+                dst.name = nodes_[v].name;
+                dst.attrs = nodes_[v].attrs;
+            }
+            dst.members.insert(dst.members.end(), nodes_[v].members.begin(), nodes_[v].members.end());
+        }
+        for (size_t c = 0; c < count; ++c) {
+            if (sizes[c] > 1) summarize(next[c], label_of(next[c]) + " (+" + std::to_string(sizes[c] - 1) + ")");
+        }
+        contract(to, std::move(next));
+    }
+
+    // 在 DAG 上按拓扑序倒推可达集 (位图, 内存 n^2 / 8 字节): 子节点按拓扑序处理,
+    // 已经能从前面的子节点到达的子节点, 它的边就是多余的
+    void transitive_reduction() {
+        size_t count = 0;
+        scc(count);
+        if (count != nodes_.size()) {
+            throw RequiredArgumentError("collapse_scc (transitive_reduction needs an acyclic graph)");
+        }
+
+        const size_t n = nodes_.size();
+        std::vector<std::vector<uint32_t>> adj = adjacency(false);
+        std::vector<uint32_t> indegree(n, 0), topo, pos(n, 0);
+        topo.reserve(n);
+        for (const Edge& e : edges_) {
+            if (e.tail != e.head) ++indegree[e.head];
+        }
+        for (uint32_t v = 0; v < n; ++v) {
+            if (indegree[v] == 0) topo.push_back(v);
+        }
+        for (size_t i = 0; i < topo.size(); ++i) {
+            for (uint32_t w : adj[topo[i]]) {
+                if (w != topo[i] && --indegree[w] == 0) topo.push_back(w);
+            }
+        }
+        for (size_t i = 0; i < n; ++i) pos[topo[i]] = static_cast<uint32_t>(i);
+
+        const size_t words = (n + 63) / 64;
+        std::vector<uint64_t> reach(n * words, 0);
+        std::unordered_set<uint64_t> redundant;
+        for (size_t i = n; i-- > 0;) {
+            uint32_t u = topo[i];
+            uint64_t* ru = &reach[u * words];
+            ru[u / 64] |= uint64_t(1) << (u % 64);
+            std::vector<uint32_t>& children = adj[u];
+            std::sort(children.begin(), children.end(), [&pos](uint32_t a, uint32_t b) { return pos[a] < pos[b]; });
+            for (uint32_t v : children) {
+                if (v == u) continue;
+                if (ru[v / 64] & (uint64_t(1) << (v % 64))) {
+                    redundant.insert(pair_key(u, v));
+                    continue;
+                }
+                const uint64_t* rv = &reach[v * words];
+                for (size_t k = 0; k < words; ++k) ru[k] |= rv[k];
+            }
+        }
+
+        std::vector<Edge> kept;
+        kept.reserve(edges_.size() - redundant.size());
+        for (const Edge& e : edges_) {
+            if (! redundant.count(pair_key(e.tail, e.head))) kept.push_back(e);
+        }
+        edges_.swap(kept);
+    }
+
+    void fold_leaves(const std::vector<std::string>& roots, size_t min_leaves) {
+        const size_t n = nodes_.size();
+        std::vector<size_t> degree(n, 0);
+        for (const Edge& e : edges_) {
+            if (e.tail == e.head) continue;
+            ++degree[e.tail];
+            ++degree[e.head];
+        }
+        std::unordered_set<std::string> keep(roots.begin(), roots.end());
+
+        // 叶子按 (所挂的节点, 方向) 分组: 0 = 叶子是后继 (或无向), 1 = 叶子是前驱
+        std::unordered_map<uint64_t, std::vector<uint32_t>> groups;
+        std::vector<uint64_t> group_order;
+        for (const Edge& e : edges_) {
+            if (e.tail == e.head) continue;
+            uint32_t leaf, parent;
+            uint64_t side;
+            if (degree[e.head] == 1 && degree[e.tail] > 1) {
+                leaf = e.head, parent = e.tail, side = 0;
+            } else if (degree[e.tail] == 1 && degree[e.head] > 1) {
+                leaf = e.tail, parent = e.head, side = directed_ ? 1 : 0;
+            } else {
+                continue;
+            }
+            if (keep.count(nodes_[leaf].name)) continue;
+            uint64_t key = (static_cast<uint64_t>(parent) << 1) | side;
+            std::vector<uint32_t>& g = groups[key];
+            if (g.empty()) group_order.push_back(key);
+            g.push_back(leaf);
+        }
+
+        std::vector<int64_t> to(n);
+        for (size_t v = 0; v < n; ++v) to[v] = static_cast<int64_t>(v);
+        std::vector<Node> summaries;
+        std::unordered_set<std::string> names;
+        for (const Node& node : nodes_) names.insert(node.name);
+        for (uint64_t key : group_order) {
+            const std::vector<uint32_t>& leaves = groups[key];
+            if (leaves.size() < min_leaves) continue;
+
+            Node s;
+            const char* suffix = ! directed_ ? " -- ..." : (key & 1) ? " <- ..." : " -> ...";
+            s.name = unique_name(names, nodes_[key >> 1].name + suffix);
+            for (uint32_t leaf : leaves) {
+                s.members.insert(s.members.end(), nodes_[leaf].members.begin(), nodes_[leaf].members.end());
+                to[leaf] = static_cast<int64_t>(n + summaries.size());
+            }
+            s.attrs = nodes_[leaves.front()].attrs;
+            summarize(s, std::to_string(s.members.size()) + " nodes");
+            summaries.push_back(std::move(s));
+        }
+        if (summaries.empty()) return;
+
+        // 被合并的叶子留空位, 编号压紧后再 contract
+        std::vector<Node> next;
+        std::vector<int64_t> compact(n + summaries.size(), -1);
+        for (size_t v = 0; v < n; ++v) {
+            if (to[v] != static_cast<int64_t>(v)) continue;
+            compact[v] = static_cast<int64_t>(next.size());
+            next.push_back(std::move(nodes_[v]));
+        }
+        for (size_t i = 0; i < summaries.size(); ++i) {
+            compact[n + i] = static_cast<int64_t>(next.size());
+            next.push_back(std::move(summaries[i]));
+        }
+        for (size_t v = 0; v < n; ++v) to[v] = compact[static_cast<size_t>(to[v])];
+        contract(to, std::move(next));
+    }
+
+    static std::string label_of(const Node& node) {
+        auto it = node.attrs.find("label");
+        return it == node.attrs.end() ? node.name : it->second;
+    }
+
+    // 合并节点的标签, tooltip 列出全部成员 (SVG 中悬停可见)
+    void summarize(Node& node, const std::string& label) const {
+        std::string tooltip;
+        for (uint32_t m : node.members) {
+            if (! tooltip.empty()) tooltip += '\n';
+            tooltip += original_names_[m];
+        }
+        node.attrs.set("label", label);
+        node.attrs.set("tooltip", tooltip);
+    }
+
+    static std::string unique_name(std::unordered_set<std::string>& names, const std::string& base) {
+        std::string name = base;
+        for (size_t i = 2; names.count(name); ++i) name = base + " #" + std::to_string(i);
+        names.insert(name);
+        return name;
+    }
+
+    Reduction build(const BaseGraph& g) {
+        BaseGraph out(g.name(), g.is_strict(), g.is_directed());
+        for (const auto& kv : g.graph_attr()) out.set_graph_attr(kv.first, kv.second);
+        for (const auto& kv : g.node_attr()) out.set_node_attr(kv.first, kv.second);
+        for (const auto& kv : g.edge_attr()) out.set_edge_attr(kv.first, kv.second);
+        out.reserve(nodes_.size() + edges_.size());
+
+        for (const Node& node : nodes_) out.node(node.name, "", node.attrs);
+        for (const Edge& e : edges_) {
+            out.edge(nodes_[e.tail].name, nodes_[e.head].name, edge_attrs_[e.attrs]);
+        }
+
+        Reduction r(std::move(out));
+        for (const Node& node : nodes_) {
+            std::vector<std::string>& members = r.members_[node.name];
+            for (uint32_t m : node.members) {
+                members.push_back(original_names_[m]);
+                r.representative_[original_names_[m]] = node.name;
+            }
+        }
+        r.original_nodes_ = original_nodes_;
+        r.original_edges_ = original_edges_;
+        return r;
+    }
+};
+
+// 生成 g 的降级版本用于布局; g 本身不变
+inline Reduction reduce(const BaseGraph& g, const ReduceOptions& options) {
+    return GraphReducer::run(g, options);
+}
+
+} // namespace kgraphviz
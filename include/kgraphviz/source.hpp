@@ -1,11 +1,22 @@
 #pragma once
+#include <cerrno>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <fstream>
 #include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
 #include "options.hpp"
 
 #include "detail/render.hpp"
+#include "detail/dot_parser.hpp"
+#include "detail/mapped_file.hpp"
+#include "detail/gvc_backend.hpp"
+#include "detail/render_cache.hpp"
+#include "detail/async_render.hpp"
+#include "detail/worker_pool.hpp"
 #include "detail/viewer.hpp"
 #include "detail/tmpfile.hpp"
 
@@ -16,6 +27,27 @@ class Source {
     Source(const std::string& dot_code, const SourceOptions& options = SourceOptions())
         : dot_code_(dot_code), source_options_(options) {}
 
+    // 以只读 mmap 打开 .gv 文件, 文本不复制到堆上; 渲染时映射的页直接写入 engine 的 stdin.
+    // 适合 GB 级的生成文件. 映射由副本共享, 文件在 Source 存活期间不应被截断或改写
+    static Source from_file(const std::string& path, const SourceOptions& options = SourceOptions()) {
+        Source src(std::string(), options);
+        src.mapped_ = std::make_shared<MappedFile>(path);
+        return src;
+    }
+
+    bool is_mapped() const {
+        return mapped_ != nullptr;
+    }
+
+    // DOT 文本, 对 from_file() 的 Source 指向映射区 (空文件为 nullptr)
+    const char* data() const {
+        return mapped_ ? mapped_->data() : dot_code_.data();
+    }
+
+    size_t size() const {
+        return mapped_ ? mapped_->size() : dot_code_.size();
+    }
+
     std::string source_filepath() const {
         if (source_options_.filename.empty()) {
             throw RequiredArgumentError("save() require filename arugument");
@@ -24,18 +56,124 @@ class Source {
                                                    (source_options_.directory + "/" + source_options_.filename);
     }
 
+    // 解析为 BaseGraph, 之后可以检查、去重或修改再渲染. 语法错误以 DotSyntaxError (含行列号) 报告
+    BaseGraph parse(const std::shared_ptr<MonotonicArena>& arena = nullptr) const {
+        return DotParser::parse(data(), size(), arena);
+    }
+
+    // 只检查语法, 不启动任何进程; 出错时抛出 DotSyntaxError
+    void validate() const {
+        DotParser::parse(data(), size());
+    }
+
+    // 完整文本的副本; 映射的大文件请用 data() / size()
+    std::string source() const {
+        return mapped_ ? std::string(data(), size()) : dot_code_;
+    }
+
+    // 整块 write(2) 到文件, 不经过 ofstream 的缓冲. 保存到映射的源文件自身时什么也不做
     void save() const {
-        std::ofstream out(source_filepath().c_str(), std::ios::binary);
-        if (! out) throw std::runtime_error("Failed to open file: " + source_filepath());
-        out << dot_code_;
+        std::string path = source_filepath();
+        if (mapped_ && mapped_->is_same_file(path)) return; // O_TRUNC 会截断仍在使用的映射
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) throw std::runtime_error("Failed to open file: " + path + ": " + std::strerror(errno));
+        try {
+            DotWriter out = DotWriter::to_fd(fd);
+            if (size() > 0) out.write(data(), size()); // 超过缓冲区大小的数据直接透传
+            out.flush();
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        if (::close(fd) != 0) throw std::runtime_error("Failed to write file: " + path + ": " + std::strerror(errno));
     }
 
     void render(const std::string& out_file, const RenderOptions& render_opts = RenderOptions()) const {
+        if (render_opts.cache || render_opts.backend == RenderBackend::Worker) {
+            RenderOptions opts = render_opts;
+            Renderer::deduce_format(out_file, opts);
+            write_cached_output(out_file, render_to_memory(opts), opts);
+            return;
+        }
+        if (render_opts.backend == RenderBackend::InProcess) {
+            with_text([&](const std::string& t) { GvcRenderer::render_source(t, out_file, render_opts); });
+            return;
+        }
+        if (mapped_) {
+            Renderer::render_from_producer(producer(), out_file, render_opts);
+            return;
+        }
         Renderer::render_from_string(dot_code_, out_file, render_opts);
     }
 
     std::vector<uint8_t> render_to_memory(const RenderOptions& render_opts = RenderOptions()) const {
-        return Renderer::render_from_string_to_memory(dot_code_, render_opts);
+        if (render_opts.cache) {
+            std::string key = mapped_ ? RenderCache::make_key(producer(), render_opts) :
+                                        RenderCache::make_key(dot_code_, render_opts);
+            return render_opts.cache->get_or_render(key, [&] { return render_to_memory_uncached(render_opts); });
+        }
+        return render_to_memory_uncached(render_opts);
+    }
+
+    // 见 BaseGraph::render_to_sink()
+    template <typename Sink>
+    void render_to_sink(ByteSink<Sink>& sink, const RenderOptions& render_opts = RenderOptions()) const {
+        if (render_opts.cache || render_opts.backend != RenderBackend::Subprocess) {
+            std::vector<uint8_t> data = render_to_memory(render_opts);
+            sink.append(data.data(), data.size());
+            return;
+        }
+        if (mapped_) {
+            Renderer::render_from_producer_to_sink(producer(), sink, render_opts);
+            return;
+        }
+        Renderer::render_from_string_to_sink(dot_code_, sink, render_opts);
+    }
+
+    // 见 BaseGraph::render_to_fd()
+    void render_to_fd(int fd, const RenderOptions& render_opts = RenderOptions()) const {
+        if (render_opts.cache || render_opts.backend != RenderBackend::Subprocess) {
+            FdSink sink(fd);
+            render_to_sink(sink, render_opts);
+            return;
+        }
+        if (mapped_) {
+            Renderer::render_from_producer_to_fd(producer(), fd, render_opts);
+            return;
+        }
+        Renderer::render_from_string_to_fd(dot_code_, fd, render_opts);
+    }
+
+    // 见 BaseGraph::render_outputs()
+    RenderResults render_outputs(const RenderOptions& render_opts) const {
+        if (render_opts.cache || render_opts.backend == RenderBackend::Worker) {
+            return render_outputs_each(render_opts, [this](const RenderOptions& opts) { return render_to_memory(opts); });
+        }
+        if (render_opts.backend == RenderBackend::InProcess) {
+            return with_text([&](const std::string& t) { return GvcRenderer::render_source_outputs(t, render_opts); });
+        }
+        if (mapped_) return Renderer::render_outputs_from_producer(producer(), render_opts);
+        return Renderer::render_outputs_from_string(dot_code_, render_opts);
+    }
+
+    RenderHandle render_async(const RenderOptions& render_opts = RenderOptions(),
+                              RenderHandle::Callback callback = RenderHandle::Callback()) const {
+        std::shared_ptr<Source> snapshot = std::make_shared<Source>(*this);
+        return RenderHandle::launch(
+            [snapshot](const RenderOptions& opts) { return snapshot->render_to_memory(opts); }, render_opts, callback);
+    }
+
+    RenderHandle render_async(const std::string& out_file,
+                              const RenderOptions& render_opts = RenderOptions(),
+                              RenderHandle::Callback callback = RenderHandle::Callback()) const {
+        std::shared_ptr<Source> snapshot = std::make_shared<Source>(*this);
+        return RenderHandle::launch(
+            [snapshot, out_file](const RenderOptions& opts) {
+                snapshot->render(out_file, opts);
+                return std::vector<uint8_t>();
+            },
+            render_opts,
+            callback);
     }
 
     void view(RenderOptions render_opts = RenderOptions()) const {
@@ -46,7 +184,35 @@ class Source {
     }
 
   private:
+    std::vector<uint8_t> render_to_memory_uncached(const RenderOptions& render_opts) const {
+        if (render_opts.backend == RenderBackend::InProcess) {
+            return with_text([&](const std::string& t) { return GvcRenderer::render_source(t, render_opts); });
+        }
+        if (render_opts.backend == RenderBackend::Worker) {
+            return with_text([&](const std::string& t) { return worker_pool_of(render_opts).render(t, render_opts); });
+        }
+        if (mapped_) return Renderer::render_from_producer_to_memory(producer(), render_opts);
+        return Renderer::render_from_string_to_memory(dot_code_, render_opts);
+    }
+
+    // 映射区整块交给 DotWriter, 大于缓冲区的数据不会被复制
+    DotProducer producer() const {
+        std::shared_ptr<MappedFile> mapped = mapped_;
+        return [mapped](DotWriter& out) {
+            if (mapped->size() > 0) out.write(mapped->data(), mapped->size());
+        };
+    }
+
+    // libgvc 与 worker 协议需要完整的字符串, 映射的文本只能在这里复制一份
+    template <typename F>
+    auto with_text(F f) const -> decltype(f(std::string())) {
+        if (! mapped_) return f(dot_code_);
+        std::string text(data(), size());
+        return f(text);
+    }
+
     std::string dot_code_;
+    std::shared_ptr<MappedFile> mapped_;
     SourceOptions source_options_;
 };
 
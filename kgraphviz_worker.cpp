@@ -0,0 +1,7 @@
+// 常驻渲染 worker, 供 kgraphviz::WorkerPool 使用:
+//   g++ -std=c++11 -O2 -DKGRAPHVIZ_WITH_GVC kgraphviz_worker.cpp -o kgraphviz_worker -lgvc -lcgraph
+#include "include/kgraphviz/detail/worker_main.hpp"
+
+int main() {
+    return kgraphviz::worker_main();
+}
@@ -110,6 +110,11 @@ int main() {
 
         std::cout << "🌐 Building graph..." << std::endl;
         kgraphviz::DiGraph g("PacmanDeps");
+        g.enable_dedup(); // 同一个依赖会被多个包重复引用
+
+        std::size_t n_statements = 0;
+        for (const auto& pair : deps_map) n_statements += 1 + 2 * pair.second.size();
+        g.reserve(n_statements);
 
         for (const auto& pair : deps_map) {
             const std::string& pkg = pair.first;